@@ -28,6 +28,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  * This utility takes DSX file as input. The DSX file is generated from DS Designer through "export" command
  * This utility search component (job, routine and etc) and write to an individual file.
  * File name of the output file is same as the component name, with ".dsx" as file name extention.
+ * An XML export (DS Designer "Export as XML") is taken too, and split into ".xml" files the same way.
  * Output file always in a subfolder according its folder/hireachy in DS Designer.
  *
  * Optionaly, list the component's name, type and hierachy without write to file. By option -l
@@ -38,12 +39,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  * ------
  * Filter
  * ------
- *  Filter of component is applied in processing. Only following type of object are processed.
+ *  Filter of component is applied in processing. By default following type of object are processed.
  *   job(parallel and sequence),
  *   parameterSet
  *   routine
+ *   transform, stageType, sharedContainer
  *
  *   These are needed at compile time. Design time components can be ignored.
+ *   Data types (DT) and table definitions (TD) are taken only if asked by --types,
+ *   which sets the types handled for the run, e.g. --types JOB,PS,RT,TD. Blocks of the
+ *   other types are skipped to their END line, not parsed.
  *
  * ---------------------------------------
  *  Object types to be includeed in future
@@ -59,7 +64,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *    MNSRules (admin level, engine feature)
  *    stageType (admin level, engine feature)
  *    standardizationRules (admin level, engine feature)
- *    tableDefinition (design phase only, not needed in compile time, EXCLUDED EXPLICATLY)
+ *    tableDefinition (design phase only, not needed in compile time, off unless --types TD)
  *
  *
  *
@@ -72,14 +77,46 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  * 	Error: input file must be provided!
 
  * 	Usage:
- * 	    a <.dsx file> [-lqhoc] [-o outdir]
+ * 	    a <.dsx file>... [-lqhoc] [-o outdir]
 
  *
  * 	Allowed options:
- * 	  -f [ --file ] arg        REQUIED. Input .dsx file
+ * 	  -f [ --file ] arg        REQUIED. Input .dsx file, repeatable (* and ? in name)
+ * 	  --file-list arg          Input .dsx files listed in this file, one per line
  * 	  -l [ --list ]            List components only (No write)
  * 	  -q [ --quiet ]           Suppress output(quiet)
  * 	  -o [ --outdir ] arg (=.) Output dir (Default: current working directory)
+ * 	  -c [ --stdin ]           DSX file content from stdin, streamed
+ * 	  --no-mmap                Read input into memory instead of mapping it
+ * 	  --copy-range             Copy bodies from input to output file in the kernel (Linux)
+ * 	  --no-sync                Don't flush the files written to disk at the end (scratch output)
+ * 	  --stats [=arg(=text)]    Report phase times, bytes, counts and peak RSS to stderr, --stats=json as JSON
+ * 	  --stats-out arg          --stats report to this file instead
+ * 	  --memory-limit arg (=0)  MB, stream inputs that would need more (0: no limit)
+ * 	  -j [ --jobs ] arg (=1)   Writer threads
+ * 	  --parse-jobs arg (=0)    Parser threads (0: one per core)
+ * 	  -i [ --incremental ]     Write only new or changed components
+ * 	  --prune                  With -i, remove files of components gone since last run
+ * 	  --index                  Use <file>.dsxidx instead of parsing, (re)write it when not valid
+ * 	  --only arg               Only components of this name (pattern, * and ?), repeatable
+ * 	  --type arg               Only components of this type, e.g. DSJOB or JOB (pattern), repeatable
+ * 	  --category arg           Only components in this category, \\Jobs\\* or as path (pattern), repeatable
+ * 	  --strip-binaries         Leave compiled job executables (DSEXECJOB) and binaries (DSBPBINARY) out
+ * 	  --types arg              Types handled, others skipped unread, e.g. JOB,PS,RT,TD (default: all but DT,TD)
+ * 	  --closure arg            Only this component (pattern) and the parameter sets, routines and shared containers it uses, repeatable
+ * 	  --closure-dsx arg        With --closure, write them as one .dsx to this file (- for stdout), not a tree
+ * 	  --tar                    Write the files into one tar archive, -o <file> (- for stdout), not a tree
+ * 	  -z [ --gzip ]            With --tar, gzip compressed (default for -o *.gz, *.tgz)
+ * 	  --compose arg            Compose one .dsx from a split tree, to -o <file> (- for stdout)
+ * 	  --diff                   List components added, removed or changed from the 1st to the 2nd file, no write
+ * 	  --diff-ignore arg        With --diff, attribute not compared, e.g. DateModified, repeatable
+ * 	  -u [ --unified ]         With --diff, unified diff of each changed component
+ * 	  --gen-synthetic arg      Write a synthetic .dsx to this file, see --gen-spec
+ * 	  --gen-spec arg           Size of --gen-synthetic output
+ * 	                           (=jobs=1000,routines=200,paramsets=20,body=4096,depth=3,seed=1)
+ * 	  --bench arg              Time read, parse, pack and write of this .dsx (best of 3), into -o
+ * 	  --bench-out arg (=dsxcut-bench.jsonl)
+ * 	                           --bench results appended to this file, a JSON line per run
  * 	  -h [ --help ]            This help msg
  *
  *
@@ -89,6 +126,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  * Return Code:
  * 	0: 	success
  * 	non-0:	error
+ * 	with --diff, 1: the exports differ
  *
  *
  * ************
@@ -114,10 +152,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *
  * 		--------------------------------------------
  * 		jin@host ~/py/cutter
- * 		$ clear;time cat ct.cpp | /usr/bin/i686-w64-mingw32-g++ -O2 --std=c++11 -g -xc++ - -L/usr/i686-w64-mingw32/sys-root/mingw/lib  -l:libboost_system.a -l:libboost_filesystem.a -l:libboost_regex.a -l:libboost_program_options.a -l:libstdc++.a -l:libpthread.a -static-libgcc -static-libstdc++ -static -o dsxcut && time ./dsxcut.exe *.dsx
+ * 		$ clear;time /usr/bin/i686-w64-mingw32-g++ -O2 --std=c++11 -g ct.cpp dsxcut.cpp -L/usr/i686-w64-mingw32/sys-root/mingw/lib  -l:libboost_system.a -l:libboost_filesystem.a -l:libboost_regex.a -l:libboost_program_options.a -l:libz.a -l:libstdc++.a -l:libpthread.a -static-libgcc -static-libstdc++ -static -o dsxcut && time ./dsxcut.exe *.dsx
  *
  * 		--------------------------------------------
  *
+ * 	zlib (-l:libz.a) is for --tar -z and .gz input; without it, build with -DZLIB=0.
+ *
+ * 	ct.cpp is the command line. The parser and writers are in dsxcore.h and dsxcut.cpp,
+ * 	also built alone as libdsxcut with its interface dsxcut.h (see README, Library):
+ * 		g++ -O2 --std=c++11 -c dsxcut.cpp && ar rcs libdsxcut.a dsxcut.o
+ *
  * 	Optionally, install boost source (required for Linux only, if no root/admin permission is obtained),
  * 		build and link with main program as practice for Linux environment building process.
  *
@@ -160,6 +204,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *
  */
 
+
 #define BOOST
 #define DEBUG 0
 
@@ -167,41 +212,28 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define D(x) x
 #else
 #define D(x)
-
 #endif
 
+#include "dsxcore.h"
 
-#include <string>
-#include <iostream>
-
-#include <sys/types.h>
-#include <sys/stat.h>	// stat()
-
-#include <fstream>
-#include <streambuf>
-#include <cstdlib>
-//#include <filesystem>	// create_directoryies(), cwd()
-
-
-//#include <conio>	// getchar()
-
-#include <unistd.h>
-//#include <stacktrace>
-
+#include <random>	// --gen-synthetic
 #ifdef BOOST
-//#include <boost/system>
 #include <boost/regex.hpp>
-#include <boost/filesystem.hpp>
-#include <boost/program_options.hpp>
 #else
 #include <regex>		// require c++11 up
 #endif
+#include <boost/program_options.hpp>
 
-
-using namespace std;
 namespace po = boost::program_options;
+using namespace dsxcore;
 
-bool b_oList=false, b_oQuiet=false, b_oStdin=false;
+bool b_oList=false, b_oQuiet=false, b_oStdin=false, b_oNoMmap=false, b_oCopyRange=false;
+bool b_oIncremental=false, b_oPrune=false, b_oIndex=false, b_oStripBinaries=false, b_oNoSync=false;
+int n_oJobs=1, n_oParseJobs=0, n_oMemLimit=0;
+
+Stats run_stats;
+TarSink *tar_sink = NULL;	// --tar, instead of files
+std::unique_ptr<CompTypeTable> comp_table;	// --types, made in main() once comp_types is
 
 bool validate16(const std::string &s) {
 #ifdef BOOST
@@ -214,410 +246,98 @@ bool validate16(const std::string &s) {
 }
 
 
-
-
-template<typename ... Args>
-std::string string_format(const std::string & format, Args ... args) {
-	int size_s = std::snprintf(nullptr, 0, format.c_str(), args ...) +1;
-	if (size_s < 0) {throw std::runtime_error("Error in string_format()");}
-	auto size = static_cast <size_t>(size_s);
 	
-	std::unique_ptr<char[]> buf(new char[size]);
-	std::snprintf(buf.get(), size, format.c_str(), args ...);
-	return std::string(buf.get(), buf.get() + size -1);
 
-}
-
-#define DSXNEWLINE "\x0d\x0a"
-typedef struct {
-	string type_short;
-	string type;
-	int entity_level;	// if 2, with 1st level seperator as "^   DSRECORD$".
-	int name_level;
-	int cate_level;
-	string name_prefix;
-	string cate_prefix;
-}comp_t;
-
-enum {
-	F_TYPE,
-	F_BSTART,
-	F_BEND,
-	F_LEVEL,
-	F_NSTART,
-	F_NEND,
-	F_NQUOTE
-};
-
-std::vector<comp_t> comp_types {
-	    {"HD", "HEADER" ,  1, 0, 0, "Identifier", "Category"},
-	    {"JOB", "DSJOB" , 1, 1, 2, "Identifier", "Category"},
-	    // {"DT", "DSDATATYPES" , 2, 2, 2, "Identifier", "Category"},	// not needed at runtime
-	    {"PS", "DSPARAMETERSETS" , 2,2, 2, "Identifier", "Category"},
-	    // {"TD", "DSTABLEDEFS" , 2, 2, 2, "Identifier",  "Category"},	// not needed at runtime
-	    {"RT", "DSROUTINES" , 2, 2, 2, "Identifier",  "Category"},
-
-	    // Assumed ... , to be confirmed/tested !!!!
-	    {"TR", "DSTRANSFORMES" , 2, 2, 2, "Identifier",  "Category"},
-	    {"ST", "DSSTAGETYPES" , 2, 2, 2, "Identifier",  "Category"},
-	    {"SC", "DSSHAREDCONTAINER" , 1, 1, 2, "Identifier",  "Category"},
-
-	    // Binaries of component is explicitly excluded/ignored !!! As assumption that execution
-	    // enviroments configureation generally are not the same, therefore, compilation is requireed
-	    // after code promotion/imported.
-};
-
-
-
-bool withCRLF(string str, size_t pos) {
-	if (0 == str.compare(pos, strlen(DSXNEWLINE), DSXNEWLINE))
-		return true;
-	return false;
-}
-
-bool skipCRLF(string str, size_t & pos) {
-	if (withCRLF(str, pos)) {
-		pos += strlen(DSXNEWLINE);
-		return true;
-	}
-	else {
-		return false;
-	}
-}
-class Component {
 
-	private:
-	string mBody;
-	string mType;
-	string mName;
-	string mCate;
-
-	//int ofs_curr;
-
-	public:
-	Component() {}
-	Component(std::string body, std::string type, std::string name, std::string cate)
-       	{
-		setBody(body);
-		setType(type);
-		setName(name);
-		setCate(cate);
-	}
-	static inline std::string getDirSeptChar() {
-#ifdef _WIN32
-		//std::cout << "It is WIN32 FS" << std::endl;
-		return "\\";
-#else
-		//std::cout << "It is Unix/Linux FS " << std::endl;
-		return "/";
-#endif
-	}
-	void clear() {
-		mBody.clear();
-		mType.clear();
-		mName.clear();
-		mCate.clear();
-	}
-
-	std::string getPath() {
-		boost::regex expr("\\\\\\\\");
-		std::string fmt(Component::getDirSeptChar());
-		return boost::regex_replace(mCate, expr, fmt);
-
-	}
-
-	void setBody(std::string body) { mBody = body; }
-	void setType(std::string type) { mType = type; }
-	void setName(std::string name) { mName = name; }
-	void setCate(std::string cate) { mCate = cate; }
-	std::string getBody() {return mBody;}
-	std::string getType() {return mType;}
-	std::string getName() {return mName;}
-	std::string getCate() {return mCate;}
-
-	int getLevelByType(std::string type) {
-		int hit = -1;
-		int i=0;
-		for(comp_t elem: comp_types) {
-			if (elem.type == type) {hit = 1; break;}
-			i++;
-		}
-
-		if (hit == 0) {
-			//std::cout << "getLevelByType(): hit=0, return -1" <<std::endl;
-			return -1;
-		}
+po::options_description desc("Allowed options");
 
-		return comp_types[i].entity_level;
-	}
+void usage(int argc, char ** argv) {
+	std::cout << std::endl;
+	std::cout << "Usage: " << std::endl<< "    " << argv[0] << " <.dsx file>... [-lqhoc] [-o outdir] " << std::endl << std::endl;
+	std::cout << desc <<std::endl;
+	std::cout << "    Built with gcc" << __VERSION__ << ", at "<< __TIME__ <<" "<< __DATE__ << std::endl;
 
-	std::string getAttr(int level, std::string str){
-		std::string spa = ((level==1)? "   ": "      " ) + str + " \"([^\"]+)\"" DSXNEWLINE;
-		boost::regex expr { spa };
-		boost::smatch result;
-		if (boost::regex_search(mBody, result, expr)) {
-			return result[1];
-		}
-		return NULL;
-	}
-		
-	std::string pack2() {
-		//std::cout <<" pack2" <<std::endl;
-		int L = getLevelByType(mType);
-		//std::cout << "pack2(): L= " <<L<<std::endl;
-		if (L < 1) {
-			//std::cout << "hit L <1 "<< std::endl;
-			return NULL;
-		}
-		string x= (L == 1)? mBody : ("   BEGIN DSRECORD"  DSXNEWLINE + mBody + "   END DSRECORD"  DSXNEWLINE);
+}
 
-		return mBody;
-	}
-	std::string pack1() {
-		//std::cout <<" pack1" <<std::endl;
-		int L = getLevelByType(mType);
-		string sType = getType();
-		//std::cout << "pack1(): type= " << sType << std::endl;
-		if (L == 1) return mBody;
-		if (L == 2) {
-			return ("BEGIN "+ sType+ DSXNEWLINE + pack2() + "END "+ sType + DSXNEWLINE);
+bool po_validate_target(int argc, char ** argv, po::variables_map vm);
+
+// input files: -f/positional ones and those listed in --file-list (one per line), a
+// * or ? in the file name part matched against the files of its dir, sorted
+std::vector<std::string> inputFiles(po::variables_map &vm) {
+	std::vector<std::string> names, files;
+	if (vm.count("file")) names = vm["file"].as<std::vector<std::string> >();
+	if (vm.count("file-list")) {
+		std::ifstream in(vm["file-list"].as<std::string>());
+		if (!in) throw string("Error: can't read file list " + vm["file-list"].as<std::string>());
+		std::string line;
+		while (std::getline(in, line)) {
+			if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+			if (!line.empty()) names.push_back(line);
 		}
-
-
-		return NULL;
 	}
-
-	/*
-	bool parseObj(string body, int &ofs); // parse and populate fields.
-
-	int search(string body, int &ofs);	// find first qualify Component ofs
-	*/
-}; //class  Component
-
-
-class Collection {
-	private:
-	std::string mBody0;
-	std::string mFilename;
-
-	std::string mHeader;
-	vector<Component*> mComponents;
-
-	int mOfs_curr;
-
-	public:
-	Collection(const char * osFile) {
-		mBody0.clear();
-		mFilename = osFile;
-	}
-	Collection() {
-		mBody0.clear();
-	}
-
-	vector<Component*> getComponents() {
-		return mComponents;
-	}
-	string getHeader() {
-		return mHeader;
-	}
-	int count () {
-		return mComponents.size();
-	}
-	std::string pack0(Component *c) {
-		if (DEBUG) std::cout <<" pack0: "<< c->getType() <<", "<< c->getName() <<std::endl;
-		return mHeader + c->pack1() ;
-	}
-	// read file, all-in-one dsx file
-	bool readFile(){
-		try {
-			std::ifstream ifs(mFilename, std::ifstream::binary | std::ifstream::in);
-			ifs.seekg(0, std::ios::end);
-			mBody0.reserve(ifs.tellg());
-			ifs.seekg(0, std::ios::beg);
-			mBody0.assign((std::istreambuf_iterator<char>(ifs)),
-				       std::istreambuf_iterator<char>());
-			ifs.close();
-		} catch(const std::exception &e) {
-			return false;
+	for (const std::string &name : names) {
+		boost::filesystem::path path(name);
+		std::string pat = path.filename().string();
+		if (pat.find_first_of("*?") == std::string::npos) {
+			files.push_back(name);
+			continue;
 		}
-
-		return true;
-	}
-	// write file, one component per file
-	bool writeFile(std::string path, std::string filename, std::string content) {
-		struct stat f_stat;
-
-		if (stat(path.c_str(), &f_stat) != 0 &&
-			 !boost::filesystem::create_directories(path)) {
-			std::string msg = string_format("Error: Can't create directory %s", path);
-			std::cout << " Failed." << msg << std::endl;
-				return false;
+		boost::filesystem::path dir = path.has_parent_path() ? path.parent_path() : boost::filesystem::path(".");
+		std::vector<std::string> found;
+		boost::system::error_code ec;
+		for (boost::filesystem::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+			if (boost::filesystem::is_regular_file(it->status()) && globMatch(pat.c_str(), it->path().filename().string().c_str()))
+				found.push_back(path.has_parent_path() ? it->path().string() : it->path().filename().string());
 		}
-		std::string fullPath = path + Component::getDirSeptChar() + filename + ".dsx";
-		
-		std::ofstream ofs(fullPath, std::ifstream::binary | std::ifstream::out);
-		ofs << content;
-		ofs.close();
-		return true;
+		if (found.empty()) files.push_back(name);	// reported as missing
+		std::sort(found.begin(), found.end());
+		files.insert(files.end(), found.begin(), found.end());
 	}
-
-
-	void parse() {
-
-		boost::regex expr0 {"(?! )BEGIN ([A-Z]*)" DSXNEWLINE ".*?[^ ]END \\1" DSXNEWLINE  };
-		boost::regex_token_iterator<std::string::iterator> it0{mBody0.begin(),mBody0.end(), expr0};
-		boost::regex_token_iterator<std::string::iterator> end0;
-
-		int cnt = 0;
-		while (it0 != end0) {
-			std::string body1 = *it0++;
-
-			int t0,t1;
-			t0 = body1.find(" ");
-			t1 = body1.find("\r\n");
-			std::string type = body1.substr(t0+1, t1+1 - t0 -2);
-	
-			int hit = -1;
-
-			int i=0;
-			for (comp_t elem : comp_types) {
-				if (elem.type == type) {hit = 1; break;}
-				i++;
-			}
-			if (hit == -1) continue;
-
-			if (DEBUG) std::cout << "type=[" << type << "]" ;
-			if (comp_types[i].entity_level == 1) {
-
-				Component *c = new Component();
-				c->setBody(body1);
-				c->setType(type);
-				if (comp_types[i].name_level> 0) {
-					c->setName(c->getAttr(comp_types[i].name_level, comp_types[i].name_prefix));
-					if (DEBUG) { std::cout << " name = [" << c->getName()  << "]"; }
-				}
-				if (comp_types[i].cate_level> 0) {
-					c->setCate(c->getAttr(comp_types[i].cate_level, comp_types[i].cate_prefix));
-					if (DEBUG) { std::cout << " cate = [" << c->getCate()  << "]"; }
-				}
-				if (DEBUG) std::cout << endl;
-
-				if (c->getType() == "HEADER") mHeader = c->getBody();
-				else mComponents.push_back(c);
-			} else if (comp_types[i].entity_level == 2) {
-
-//				std::cout << "hit 2 <<<<<<<<<<<<" <<std::endl;
-//				std::cout << body1;
-//				std::cout << "hit 2 <<<<<<<<<<<<" <<std::endl;
-
-				boost::regex expr1 {"   BEGIN (DSRECORD" DSXNEWLINE ").*?   END \\1" };		// works!
-				boost::regex_token_iterator<std::string::iterator> it1{body1.begin(),body1.end(), expr1};
-				boost::regex_token_iterator<std::string::iterator> end1;
-
-
-				int ii=0;
-				while (it1 != end1) {
-					ii++;
-					std::string body2 = *it1++;
-
-//					std::cout << "body2 <<<<<<<<<<<<" << "#" << ii <<std::endl;
-//					std::cout << body2 ;
-//					std::cout << "body2 <<<<<<<<<<<<" << "#" << ii <<std::endl;
-
-					if (DEBUG) { std::cout << endl << ""; }
-
-					Component *c = new Component();
-					c->setBody(body2);
-					c->setType(type);
-					if (comp_types[i].name_level> 0) {
-						c->setName(c->getAttr(comp_types[i].name_level, comp_types[i].name_prefix));
-						if (DEBUG) { std::cout << "\tname = [" << c->getName()  << "]"; }
-					}
-					if (comp_types[i].cate_level> 0) {
-						c->setCate(c->getAttr(comp_types[i].cate_level, comp_types[i].cate_prefix));
-						if (DEBUG) { std::cout << " cate = [" << c->getCate()  << "]"; }
-					}
-					if (DEBUG) std::cout << endl;
-
-					mComponents.push_back(c);
-				}
-			} // level 1 vs 2.
-
-
-			/*
-			//std::cout << body1 << std::endl;
-			boost::regex expr1_i {"[^ ]   Identifier \"(\\w+)\"" DSXNEWLINE};
-			boost::regex expr1_c {"[^ ]      Category \"([^\"]+)\"" DSXNEWLINE};
-			boost::smatch result_i, result_c;
-	
-			if (boost::regex_search(body1, result_c, expr1_c)) {
-				std::cout << "====cate\t" << result_c[1] <<std::endl;
-			}
-			if (boost::regex_search(body1, result_i, expr1_i)) {
-				std::cout << "====iden\t" << result_i[1] <<std::endl;
-			}
-			std::cout << "size=\t" << body1.size() << std::endl ;
-			std::cout << std::endl;
-			*/
-			
-		}// while
-	}// parse()
-
-		
-		
-
-	int dumpToFiles(string path);	// write to files
-	int merge(Component x);
-	int composeToFile(string Path, string filename);	// write to one file.
-
-
-
-}; //class Collection
-
-	
-
-
-po::options_description desc("Allowed options");
-
-void usage(int argc, char ** argv) {
-	std::cout << std::endl;
-	std::cout << "Usage: " << std::endl<< "    " << argv[0] << " <.dsx file> [-lqhoc] [-o outdir] " << std::endl << std::endl;
-	std::cout << desc <<std::endl;
-	std::cout << "    Built with gcc" << __VERSION__ << ", at "<< __TIME__ <<" "<< __DATE__ << std::endl;
-
+	return files;
 }
 
 bool po_validate(int argc, char ** argv, po::variables_map vm) {
 	// file
 	struct stat f_stat;
-	if (!vm.count("file")) {
-		std::cout << "Error: Input file need to be provided" << std::endl;
-		usage(argc, argv);
-		exit(1);
+	if (b_oStdin) {
+		// content from stdin, nothing to check
+		return po_validate_target(argc, argv, vm);
 	}
-	auto file = vm["file"].as<std::string>().c_str();
-	if (stat(file, &f_stat) != 0) {
-		std::cout << "Error: Input file " << file << " doesn't exist" << std::endl;
+	std::vector<std::string> files = inputFiles(vm);
+	if (files.empty()) {
+		std::cout << "Error: Input file need to be provided" << std::endl;
 		usage(argc, argv);
 		exit(1);
 	}
-	std::string xx;
-	if (f_stat.st_size >= xx.max_size()) {
-		std::cout << "Error: Input file too big! ";
-		std::cout << "This is a "<< 8*sizeof(size_t)<< "-bit program.";
-		exit(1);
-	}
-	
-	if (!(S_ISREG (f_stat.st_mode) &&
-		f_stat.st_mode &S_IRUSR)) {
-		std::string msg = string_format("Error: Source file \"%s\" not accessable", file);
-		std::cout << msg << std::endl;
-		usage(argc, argv);
-		exit(1);
+	for (const std::string &name : files) {
+		auto file = name.c_str();
+		if (stat(file, &f_stat) != 0) {
+			std::cout << "Error: Input file " << file << " doesn't exist" << std::endl;
+			usage(argc, argv);
+			exit(1);
+		}
+		std::string xx;
+		if (f_stat.st_size >= xx.max_size()) {
+			std::cout << "Error: Input file too big! ";
+			std::cout << "This is a "<< 8*sizeof(size_t)<< "-bit program.";
+			exit(1);
+		}
+		
+		if (!(S_ISREG (f_stat.st_mode) &&
+			f_stat.st_mode &S_IRUSR)) {
+			std::string msg = string_format("Error: Source file \"%s\" not accessable", file);
+			std::cout << msg << std::endl;
+			usage(argc, argv);
+			exit(1);
+		}
 	}
 
-	// target
-	if (vm["list"].as<bool>() == 0) {
+	return po_validate_target(argc, argv, vm);
+}
+
+bool po_validate_target(int argc, char ** argv, po::variables_map vm) {
+	// target, a file with --tar
+	if (vm["list"].as<bool>() == 0 && !vm["tar"].as<bool>()) {
 		struct stat f_stat;
 		const char * outdir = vm["outdir"].as<std::string>().c_str();
 		if (DEBUG) std::cout << "Checking target dir [" << outdir << "].." << std::endl;
@@ -730,9 +450,1220 @@ void handle_eptr(std::exception_ptr eptr) {
 	}
 }
 
+/*
+ * Incremental split. The output dir keeps a manifest of what the last run wrote,
+ * one line per file: <hash> <size> <path relative to the output dir>.
+ * A component is written only if its hash or size differs from the manifest, or,
+ * without a manifest entry, from the file already there. With prune, files of the
+ * old manifest no component wrote this time are removed.
+ */
+#define MANIFEST_NAME ".dsxcut.manifest"
+
+class Manifest {
+	private:
+	typedef struct { uint64_t hash; uint64_t size; } entry_t;
+	std::string mDir;
+	std::map<std::string, entry_t> mOld, mNew;
+	std::mutex mMutex;
+	std::atomic<int> mWritten, mSkipped;
+	int mRemoved;
+
+	public:
+	Manifest(const std::string &dir) : mDir(dir), mWritten(0), mSkipped(0), mRemoved(0) {
+		std::ifstream ifs(mDir + Component::getDirSeptChar() + MANIFEST_NAME);
+		std::string line;
+		while (std::getline(ifs, line)) {
+			unsigned long long h, sz;
+			int n = 0;
+			if (line.empty() || line[0] == '#') continue;
+			if (sscanf(line.c_str(), "%16llx %llu %n", &h, &sz, &n) != 2 || n == 0) continue;
+			entry_t e = {h, sz};
+			mOld[line.substr(n)] = e;
+		}
+	}
+
+	static uint64_t hash(const std::vector<piece_t> &pieces, uint64_t &size) {
+		Hash64 h;
+		size = 0;
+		for (const piece_t &pc : pieces) {
+			h.add(pc.p, pc.len);
+			size += pc.len;
+		}
+		return h.value();
+	}
+
+	// record rel (path relative to the dir) as written with content pieces.
+	// Return false if the file there already has that content.
+	bool changed(const std::string &rel, const std::vector<piece_t> &pieces) {
+		entry_t e;
+		e.hash = hash(pieces, e.size);
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mNew[rel] = e;
+		}
+
+		std::string full = mDir + rel;
+		struct stat f_stat;
+		if (stat(full.c_str(), &f_stat) != 0 || (uint64_t)f_stat.st_size != e.size) return true;
+
+		auto it = mOld.find(rel);
+		if (it != mOld.end()) return it->second.hash != e.hash || it->second.size != e.size;
+
+		// no entry, compare with the file
+		std::ifstream ifs(full, std::ifstream::binary);
+		Hash64 h;
+		char buf[64 * 1024];
+		while (ifs.read(buf, sizeof(buf)) || ifs.gcount() > 0) h.add(buf, ifs.gcount());
+		return h.value() != e.hash;
+	}
+	void written() { mWritten++; }
+	void skipped() { mSkipped++; }
+
+	// remove files of the last run that are not written this time, and the category
+	// dirs they leave empty, up to the output dir
+	void prune() {
+		const std::string sep = Component::getDirSeptChar();
+		for (auto it = mOld.begin(); it != mOld.end(); ) {
+			if (mNew.count(it->first)) {
+				++it;
+				continue;
+			}
+			if (std::remove((mDir + it->first).c_str()) == 0) mRemoved++;
+			// rel starts with sep; a dir not empty is not removed, and ends the walk
+			std::string dir = it->first;
+			for (size_t s; (s = dir.rfind(sep)) != std::string::npos && s > 0; ) {
+				dir.resize(s);
+				boost::system::error_code ec;
+				if (!boost::filesystem::remove(mDir + dir, ec)) break;
+			}
+			it = mOld.erase(it);
+		}
+	}
+	bool save() {
+		std::string path = mDir + Component::getDirSeptChar() + MANIFEST_NAME, tmp = tmpPath(path);
+		bool ok;
+		{
+			std::ofstream ofs(tmp, std::ofstream::binary);
+			ofs << "# dsxcut manifest 1\n";
+			// files of the last run not pruned are still there
+			std::map<std::string, entry_t> all(mNew);
+			all.insert(mOld.begin(), mOld.end());
+			for (const auto &it : all)
+				ofs << string_format("%016llx %llu ", (unsigned long long)it.second.hash, (unsigned long long)it.second.size) << it.first << "\n";
+			ofs.close();	// the last of it is written here
+			ok = !ofs.fail();
+		}
+		return replaceFile(tmp, path, ok);
+	}
+	std::string summary() {
+		return string_format("Written %d, skipped %d (unchanged), removed %d", (int)mWritten, (int)mSkipped, mRemoved);
+	}
+}; // class Manifest
+
+// list and write one component, the n-th of N (N unknown when 0).
+// With a manifest, only if changed. Return what is to be printed for it.
+// Batch of inputs: the same component (type, category, name, body) in a later input with
+// the same header is a hard link to the file written for the first one, not written again.
+typedef struct {
+	std::shared_future<std::string> first;	// path written for the first, "" if it failed
+	std::shared_ptr<std::promise<std::string> > mine;	// set if this is the first
+} dup_t;
+
+std::string writeComponent(Collection &coll, Component *c, const std::string &targetDIR, int n, int N, Manifest *mf = NULL, dup_t *dup = NULL) {
+	std::ostringstream out;
+	std::string FullPath;
+	std::string rPath = c->getPath();
+	FullPath = targetDIR + rPath;
+
+	//std::cout <<"rPATH=["<< rPath <<"]" <<std::endl;
+	if (!b_oQuiet) {
+		string _name = c->getName();
+		string _path = c->getPath();
+		string _type = c->getType();
+		string _n = (N > 0) ? string_format("[%03d/%03d]", n, N) : string_format("[%03d]", n);
+
+		out << _n <<
+			string_format("  %-18s" , _type.c_str()) <<
+			string_format("  %-28s" , _path.c_str()) <<
+			string_format("  %-28s", _name.c_str()) << std::endl;
+	}
+
+	// write individual file
+	std::string file = FullPath + Component::getDirSeptChar() + c->getName() + coll.ext();
+	std::vector<piece_t> pieces;
+	Stats::mark_t m = run_stats.mark(true);
+	if (!b_oList) coll.pack0(c, pieces);
+	run_stats.add(Stats::PACK, m, true);
+	if (run_stats.on && !b_oList) {
+		size_t bytes = 0;
+		for (const piece_t &p : pieces) bytes += p.len;
+		run_stats.component(c->getType(), rPath, c->getName(), bytes);
+	}
+	m = run_stats.mark(true);
+	if (!b_oList && mf && !mf->changed(rPath + Component::getDirSeptChar() + c->getName() + coll.ext(), pieces)) {
+		mf->skipped();
+		if (dup && dup->mine) dup->mine->set_value(file);
+		return out.str();
+	}
+	if (!b_oList && dup && !dup->mine) {
+		std::string first = dup->first.get();
+		if (!first.empty() && coll.linkFile(first, FullPath, c->getName(), out)) {
+			run_stats.add(Stats::WRITE, m, true);
+			run_stats.linked();
+			if (mf) mf->written();
+			return out.str();
+		}
+	}
+	bool ok = b_oList || coll.writeFile(FullPath, c->getName(), pieces, out);
+	if (!b_oList) run_stats.add(Stats::WRITE, m, true);
+	if (dup && dup->mine) dup->mine->set_value(ok ? file : "");
+	if (!ok) {
+		run_stats.writeError();
+		out << "Error: fail to write file [" <<FullPath << Component::getDirSeptChar() << c->getName() << "]" << std::endl;
+
+	} else if (!b_oList && mf) {
+		mf->written();
+	}
+	return out.str();
+}
+
+/*
+ * Pipeline from parse to write: the parsing thread submits one task per component
+ * into a bounded queue, drained by N writer threads that pack and write. Tasks
+ * finish in any order, the text they return is printed in submission order.
+ * With 1 thread tasks run right away in the submitting thread.
+ */
+class WritePool {
+	private:
+	std::vector<std::thread> mThreads;
+	std::deque<std::pair<size_t, std::function<std::string()> > > mQueue;
+	std::map<size_t, std::string> mDone;	// output of finished tasks, waiting for their turn
+	size_t mMaxQueue;
+	size_t mSubmitted;
+	size_t mPrinted;
+	bool mClosed;
+	std::mutex mMutex;
+	std::condition_variable mNotEmpty, mNotFull;
+
+	void work() {
+		for (;;) {
+			std::pair<size_t, std::function<std::string()> > task;
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mNotEmpty.wait(lock, [this]{ return mClosed || !mQueue.empty(); });
+				if (mQueue.empty()) return;
+				task = std::move(mQueue.front());
+				mQueue.pop_front();
+			}
+			mNotFull.notify_one();
+			done(task.first, run(task.second));
+		}
+	}
+	std::string run(std::function<std::string()> &task) {
+		try {
+			return task();
+		} catch (const std::exception &e) {
+			run_stats.writeError();	// the task's file is not written
+			return string("Error: ") + e.what() + "\n";
+		}
+	}
+	void done(size_t seq, std::string out) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		mDone[seq] = std::move(out);
+		for (auto it = mDone.begin(); it != mDone.end() && it->first == mPrinted; it = mDone.erase(it)) {
+			std::cout << it->second;
+			mPrinted++;
+		}
+	}
+
+	public:
+	WritePool(int nThreads) : mMaxQueue(4 * nThreads), mSubmitted(0), mPrinted(0), mClosed(false) {
+		for (int i = 0; nThreads > 1 && i < nThreads; i++)
+			mThreads.push_back(std::thread(&WritePool::work, this));
+	}
+	~WritePool() { finish(); }
+
+	// blocks while the queue is full
+	void submit(std::function<std::string()> task) {
+		if (mThreads.empty()) {
+			std::cout << run(task);
+			mSubmitted++;
+			mPrinted++;
+			return;
+		}
+		std::unique_lock<std::mutex> lock(mMutex);
+		mNotFull.wait(lock, [this]{ return mQueue.size() < mMaxQueue; });
+		mQueue.push_back(std::make_pair(mSubmitted++, std::move(task)));
+		lock.unlock();
+		mNotEmpty.notify_one();
+	}
+	// number of tasks done and printed
+	size_t printed() {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mPrinted;
+	}
+	size_t submitted() { return mSubmitted; }
+	// wait for all tasks and stop the threads
+	void finish() {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mClosed = true;
+		}
+		mNotEmpty.notify_all();
+		for (std::thread &t : mThreads) t.join();
+		mThreads.clear();
+		std::cout.flush();
+	}
+}; // class WritePool
+
+// after all writes of an incremental split, of a selection if sel
+void finishManifest(Manifest *mf, Selection *sel) {
+	if (mf == NULL || b_oList) return;
+	if (b_oPrune && sel) std::cout << "Warning: --prune ignored with --only/--type/--category" << std::endl;
+	else if (b_oPrune) mf->prune();
+	if (!mf->save()) std::cout << "Error: fail to write " MANIFEST_NAME << std::endl;
+	if (!b_oQuiet) std::cout << std::endl << mf->summary() << std::endl;
+}
+
+/*
+ * --compose: one .dsx from a tree written by the split, in the order of comp_types,
+ * by path within a type. Types are peeked at from the first lines of each file,
+ * then files are read and parsed in parallel, COMPOSE_WINDOW at a time, and written
+ * in order. Memory holds one window of components, not the tree.
+ */
+#define COMPOSE_WINDOW 256
+
+// type of the first component in a split .dsx, from its first lines
+std::string peekType(const std::string &path) {
+	std::ifstream ifs(path, std::ifstream::binary);
+	std::string buf;
+	char chunk[4096];
+	while (buf.size() < (1 << 20) && (ifs.read(chunk, sizeof(chunk)) || ifs.gcount() > 0)) {
+		buf.append(chunk, ifs.gcount());
+		size_t e = buf.find(DSXNEWLINE "END HEADER" DSXNEWLINE);
+		if (e == string::npos) continue;
+		size_t b = e + strlen(DSXNEWLINE "END HEADER" DSXNEWLINE);
+		size_t nl = buf.find(DSXNEWLINE, b);
+		if (nl == string::npos) continue;
+		if (buf.compare(b, 6, "BEGIN ") != 0) return "";
+		return buf.substr(b + 6, nl - b - 6);
+	}
+	return "";
+}
+
+int composeTree(const std::string &dir, const std::string &outFile, int nThreads) {
+	std::ostream &log = (outFile == "-") ? std::cerr : std::cout;
+	if (nThreads == 0) nThreads = std::thread::hardware_concurrency();
+	if (nThreads < 1) nThreads = 1;
+
+	std::vector<std::string> files;
+	try {
+		for (boost::filesystem::recursive_directory_iterator it(dir), end; it != end; ++it) {
+			if (boost::filesystem::is_regular_file(it->status()) && it->path().extension() == ".dsx")
+				files.push_back(it->path().string());
+		}
+	} catch (const std::exception &e) {
+		log << "Error: can't read directory " << dir << ": " << e.what() << std::endl;
+		return 1;
+	}
+	std::sort(files.begin(), files.end());
+
+	std::vector<std::string> types(files.size());
+	parallelFor(nThreads, files.size(), [&](size_t i) { types[i] = peekType(files[i]); });
+	std::vector<size_t> order;
+	for (size_t i = 0; i < files.size(); i++) {
+		if (comp_table->find(types[i]) && types[i] != "HEADER") order.push_back(i);
+		else log << "Warning: " << files[i] << " skipped, no component found" << std::endl;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return compTypeOrder(types[a]) < compTypeOrder(types[b]);
+	});
+	if (order.empty()) {
+		log << "** no component found in " << dir << "**" << std::endl;
+		return 0;
+	}
+
+	Composer out;
+	if (!out.open(outFile)) {
+		log << "Error: can't open " << outFile << std::endl;
+		return 1;
+	}
+	// components of one file, copied out of it
+	typedef struct {
+		std::string header;
+		std::vector<Component> comps;
+		std::vector<std::string> bodies;
+		bool ok;
+	} item_t;
+	int errors = 0;
+	bool headed = false;
+	StringPool names;	// of the copies, the collections are gone
+	for (size_t w = 0; w < order.size(); w += COMPOSE_WINDOW) {
+		size_t n = std::min((size_t)COMPOSE_WINDOW, order.size() - w);
+		std::vector<item_t> items(n);
+		parallelFor(nThreads, n, [&](size_t i) {
+			Collection coll(files[order[w + i]].c_str());
+			coll.handle(comp_table.get());
+			item_t &it = items[i];
+			it.ok = coll.readFile();
+			if (!it.ok) return;
+			coll.parse(1);
+			it.header = coll.getHeader();
+			for (Component *c : coll.getComponents()) {
+				it.bodies.push_back(c->getBody());
+				it.comps.push_back(Component(NULL, c->getSpan(), c->getType(), c->getName(), c->getCate(), names));
+			}
+		});
+		for (size_t i = 0; i < n; i++) {
+			item_t &it = items[i];
+			if (!it.ok || it.comps.empty()) {
+				log << "Error: fail to read component from " << files[order[w + i]] << std::endl;
+				errors++;
+				continue;
+			}
+			if (!headed) {
+				out.header(it.header);
+				headed = true;
+			}
+			for (size_t k = 0; k < it.comps.size(); k++)
+				out.add(&it.comps[k], it.bodies[k].data(), it.bodies[k].size());
+			if (!b_oQuiet && outFile != "-") {
+				log << string_format("[%03d/%03d]", (int)(w + i + 1), (int)order.size()) <<
+					string_format("  %-18s", it.comps[0].getType().c_str()) <<
+					string_format("  %-28s", it.comps[0].getPath().c_str()) <<
+					string_format("  %-28s", it.comps[0].getName().c_str()) << std::endl;
+			}
+		}
+	}
+	if (!out.finish()) {
+		log << "Error: fail to write " << outFile << std::endl;
+		return 1;
+	}
+	if (!b_oQuiet) log << std::endl << "Composed " << out.count() << " components from " << order.size() << " files" << std::endl;
+	return errors ? 1 : 0;
+}
+
+// exact --only names that were not found
+void reportPending(Selection *sel) {
+	if (sel == NULL) return;
+	for (const std::string &name : sel->pending())
+		if (name.find_first_of("*?") == string::npos) std::cerr << "Warning: component " << name << " not found" << std::endl;
+}
+
+/*
+ * --gen-synthetic: a made-up export to benchmark with, shaped like a real one. The
+ * spec is key=value,... of
+ *   jobs, routines, paramsets	number of each (DSJOB, DSROUTINES and DSPARAMETERSETS records)
+ *   body			approximate bytes of a job, routines and parameter sets get 1/4
+ *   depth			up to this many category levels below \Jobs, \Routines, ...
+ *   seed			same seed, same file
+ */
+int genSynthetic(const std::string &file, const std::string &spec) {
+	std::map<std::string, unsigned long> opt = {
+		{"jobs", 1000}, {"routines", 200}, {"paramsets", 20}, {"body", 4096}, {"depth", 3}, {"seed", 1}};
+	std::istringstream ss(spec);
+	std::string kv;
+	while (std::getline(ss, kv, ',')) {
+		size_t eq = kv.find('=');
+		if (eq == string::npos || !opt.count(kv.substr(0, eq))) throw string("Error: bad --gen-spec item [" + kv + "]");
+		opt[kv.substr(0, eq)] = std::stoul(kv.substr(eq + 1));
+	}
+
+	FILE *fp = fopen(file.c_str(), "wb");
+	if (fp == NULL) {
+		std::cerr << "Error: can't create " << file << std::endl;
+		return 1;
+	}
+	std::vector<char> vbuf(1 << 20);
+	setvbuf(fp, vbuf.data(), _IOFBF, vbuf.size());
+	std::mt19937 rng(opt["seed"]);
+	auto L = [fp](const std::string &line) { fputs(line.c_str(), fp); fputs("\r\n", fp); };
+	auto cate = [&](const char *top) {
+		std::string s = string_format("\\\\%s", top);
+		for (unsigned long d = 0, n = opt["depth"] ? rng() % opt["depth"] + 1 : 0; d < n; d++)
+			s += string_format("\\\\Level%lu_%u", d + 1, (unsigned)(rng() % 4));
+		return s;
+	};
+	auto date = [&](const char *ind) {
+		L(string_format("%sDateModified \"2023-%02u-%02u\"", ind, (unsigned)(rng() % 12 + 1), (unsigned)(rng() % 28 + 1)));
+		L(string_format("%sTimeModified \"%02u.%02u.00\"", ind, (unsigned)(rng() % 24), (unsigned)(rng() % 60)));
+	};
+	// code lines of about n bytes
+	auto code = [&](size_t n) {
+		for (size_t len = 0, i = 0; len < n; i++) {
+			std::string s = string_format("If DSU.RT_Check_%u(Arg%lu) Then Ans = Ans + %u Else Ans = 0", (unsigned)(rng() % 100), (unsigned long)i, (unsigned)rng());
+			L(s);
+			len += s.size() + 2;
+		}
+	};
+
+	L("BEGIN HEADER");
+	L("   CharacterSet \"CP1252\"");
+	L("   ExportingTool \"IBM InfoSphere DataStage Export\"");
+	L("   ToolVersion \"8\"");
+	L("   ServerName \"SYNTHETIC\"");
+	L("   ToolInstanceID \"BENCH\"");
+	L("   MDISVersion \"1.0\"");
+	L("   Date \"2023-01-01\"");
+	L("   Time \"10.00.00\"");
+	L("   ServerVersion \"11.7\"");
+	L("END HEADER");
+	for (unsigned long i = 0; i < opt["jobs"]; i++) {
+		std::string name = string_format("Job_%06lu", i);
+		L("BEGIN DSJOB");
+		L("   Identifier \"" + name + "\"");
+		date("   ");
+		L("   BEGIN DSRECORD");
+		L("      Identifier \"ROOT\"");
+		L("      OLEType \"CJobDefn\"");
+		L("      Readonly \"0\"");
+		L("      Name \"" + name + "\"");
+		L("      Description \"Synthetic job\"");
+		L("      Category \"" + cate("Jobs") + "\"");
+		L("      BEGIN DSSUBRECORD");
+		L("         Name \"PS_Common\"");
+		L("         ParamType \"13\"");
+		L("      END DSSUBRECORD");
+		L("      JobType \"3\"");
+		L("   END DSRECORD");
+		for (size_t s = 0, len = 400; len < opt["body"]; s++, len += 330) {
+			L("   BEGIN DSRECORD");
+			L(string_format("      Identifier \"V0S%lu\"", (unsigned long)s));
+			L("      OLEType \"CTransformerStage\"");
+			L(string_format("      Name \"xfm%lu\"", (unsigned long)s));
+			L("      BEGIN DSSUBRECORD");
+			L("         Name \"Derivation\"");
+			L("         Value =+=+=+=");
+			code(150);
+			L("=+=+=+=");
+			L("      END DSSUBRECORD");
+			L("   END DSRECORD");
+		}
+		L("END DSJOB");
+	}
+	const struct { const char *type, *prefix, *top; unsigned long n; } lvl2[] = {
+		{"DSROUTINES", "RT_", "Routines", opt["routines"]},
+		{"DSPARAMETERSETS", "PS_", "Parameter Sets", opt["paramsets"]},
+	};
+	for (const auto &t : lvl2) {
+		if (t.n == 0) continue;
+		L(string("BEGIN ") + t.type);
+		for (unsigned long i = 0; i < t.n; i++) {
+			L("   BEGIN DSRECORD");
+			L(string_format("      Identifier \"%s%06lu\"", t.prefix, i));
+			date("      ");
+			L("      Category \"" + cate(t.top) + "\"");
+			L("      Source =+=+=+=");
+			code(opt["body"] / 4);
+			L("=+=+=+=");
+			L("   END DSRECORD");
+		}
+		L(string("END ") + t.type);
+	}
+	bool ok = !ferror(fp);
+	if (fclose(fp) != 0) ok = false;
+	if (!ok) {
+		std::cerr << "Error: fail to write " << file << std::endl;
+		return 1;
+	}
+	if (!b_oQuiet) std::cout << string_format("Generated %s: %lu jobs, %lu routines, %lu parameter sets",
+		file.c_str(), opt["jobs"], opt["routines"], opt["paramsets"]) << std::endl;
+	return 0;
+}
+
+/*
+ * --bench: time the phases of a split of file one by one, best of BENCH_RUNS: readFile,
+ * parse (--parse-jobs), pack0 of all components, writeFile of them (-j writers) into
+ * a scratch dir under targetDIR. Then the marker search kernels alone, each over the
+ * whole file. Results are printed and appended to resultFile as one JSON line, to
+ * follow over versions.
+ */
+#define BENCH_RUNS 3
+int benchFile(const std::string &file, const std::string &targetDIR, const std::string &resultFile) {
+	const char *names[] = {"readFile", "parse", "pack0", "writeFile"};
+	double best[4] = {0, 0, 0, 0};
+	size_t bytes[4] = {0, 0, 0, 0};
+	size_t N = 0;
+	std::string scratch = targetDIR + Component::getDirSeptChar() + ".dsxcut-bench";
+	boost::system::error_code ec;
+	std::atomic<int> errors(0);
+
+	for (int r = 0; r < BENCH_RUNS; r++) {
+		double secs[4];
+		Collection coll(file.c_str());
+		coll.handle(comp_table.get());
+		auto t0 = std::chrono::steady_clock::now();
+		auto lap = [&t0]() {
+			auto t1 = std::chrono::steady_clock::now();
+			double d = std::chrono::duration<double>(t1 - t0).count();
+			t0 = t1;
+			return d;
+		};
+		if (!coll.readFile()) {
+			std::cerr << "Error in read file [" << file << "]. Quit" << std::endl;
+			return 1;
+		}
+		secs[0] = lap();
+		coll.parse(n_oParseJobs);
+		secs[1] = lap();
+		std::vector<Component*> comps = coll.getComponents();
+		N = comps.size();
+		std::vector<std::vector<piece_t> > packed(N);
+		for (size_t i = 0; i < N; i++) coll.pack0(comps[i], packed[i]);
+		secs[2] = lap();
+		boost::filesystem::remove_all(scratch, ec);
+		t0 = std::chrono::steady_clock::now();
+		parallelFor(n_oJobs, N, [&](size_t i) {
+			std::ostringstream log;
+			if (!coll.writeFile(scratch + comps[i]->getPath(), comps[i]->getName(), packed[i], log)) errors++;
+		});
+		secs[3] = lap();
+
+		bytes[0] = bytes[1] = coll.bytes();
+		bytes[2] = 0;
+		for (const auto &pieces : packed)
+			for (const piece_t &p : pieces) bytes[2] += p.len;
+		bytes[3] = bytes[2];
+		for (int k = 0; k < 4; k++)
+			if (r == 0 || secs[k] < best[k]) best[k] = secs[k];
+	}
+	boost::filesystem::remove_all(scratch, ec);
+
+	// marker search kernels over the file, and a line by line memchr() for reference
+	std::ifstream ifs(file, std::ifstream::binary);
+	std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+	std::vector<std::pair<const char *, marker_fn> > kernels = markerKernels();
+	std::vector<std::pair<std::string, double> > markers;
+	std::vector<size_t> counts;	// of each kernel, all the same
+	volatile size_t sink = 0;	// keeps the loops
+	for (size_t k = 0; k <= kernels.size(); k++) {
+		double secs = 0;
+		for (int r = 0; r < BENCH_RUNS; r++) {
+			auto t0 = std::chrono::steady_clock::now();
+			size_t found = 0;
+			if (k < kernels.size()) {
+				for (size_t i = 1; (i = kernels[k].second(data.data(), i, data.size(), false)) < data.size(); i++) found++;
+			} else {
+				for (const char *q = data.data(), *e = q + data.size(); q < e; found++) {
+					const char *nl = (const char *)memchr(q, '\n', e - q);
+					q = nl ? nl + 1 : e;
+				}
+			}
+			double d = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+			sink = sink + found;
+			if (r == 0 || d < secs) secs = d;
+			if (r == 0 && k < kernels.size()) counts.push_back(found);
+		}
+		markers.push_back(std::make_pair(k < kernels.size() ? kernels[k].first : "memchr_lines",
+			secs > 0 ? data.size() / secs / (1024.0 * 1024.0) : 0));
+	}
+
+	std::ostringstream json;
+	time_t now = time(NULL);
+	char stamp[32];
+	strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+	json << "{\"time\":\"" << stamp << "\",\"build\":\"" << __DATE__ << " " << __TIME__ << "\""
+		<< ",\"file\":\"" << boost::filesystem::path(file).filename().string() << "\""
+		<< ",\"bytes\":" << bytes[0] << ",\"components\":" << N
+		<< ",\"parse_jobs\":" << n_oParseJobs << ",\"jobs\":" << n_oJobs << ",\"runs\":" << BENCH_RUNS << ",\"phases\":{";
+	for (int k = 0; k < 4; k++) {
+		double mbps = best[k] > 0 ? bytes[k] / best[k] / (1024.0 * 1024.0) : 0;
+		double cps = best[k] > 0 ? N / best[k] : 0;
+		if (!b_oQuiet) std::cout << string_format("%-10s %9.4fs %10.1f MB/s %12.0f components/s", names[k], best[k], mbps, cps) << std::endl;
+		json << (k ? "," : "") << string_format("\"%s\":{\"secs\":%.6f,\"MBps\":%.1f,\"comps_per_s\":%.0f}", names[k], best[k], mbps, cps);
+	}
+	json << "},\"markers\":{";
+	for (size_t k = 0; k < markers.size(); k++) {
+		if (!b_oQuiet) std::cout << string_format("marker %-12s %10.1f MB/s", markers[k].first.c_str(), markers[k].second) << std::endl;
+		json << (k ? "," : "") << string_format("\"%s\":%.1f", markers[k].first.c_str(), markers[k].second);
+	}
+	json << "}}";
+	std::ofstream out(resultFile, std::ios::app);
+	out << json.str() << std::endl;
+	if (!out) {
+		std::cerr << "Error: fail to write " << resultFile << std::endl;
+		return 1;
+	}
+	if (errors) std::cerr << "Error: " << errors / BENCH_RUNS << " files not written" << std::endl;
+	for (size_t k = 1; k < counts.size(); k++) {
+		if (counts[k] == counts[0]) continue;
+		std::cerr << "Error: marker kernel " << kernels[k].first << " found " << counts[k] << ", "
+			<< kernels[0].first << " " << counts[0] << std::endl;
+		errors++;
+	}
+	return errors ? 1 : 0;
+}
+
+/*
+ * --diff a.dsx b.dsx: components added, removed and changed from a to b, matched by
+ * type, category and name and compared by hash. Lines of the attributes in ignore
+ * ('<indent>DateModified "..."') are left out of the comparison. With unified, a
+ * unified diff of the lines of each changed component (Myers). Nothing is written.
+ */
+typedef struct { const char *p; size_t len; } line_t;
+
+// lines of c without line ends, those of an attribute in ignore left out
+std::vector<line_t> diffLines(Component *c, const std::set<std::string> &ignore) {
+	std::vector<line_t> lines;
+	std::vector<piece_t> pieces;
+	c->bodyPieces(pieces);	// holes are whole lines
+	for (const piece_t &pc : pieces) {
+		const char *p = pc.p, *e = p + pc.len;
+		while (p < e) {
+			const char *nl = (const char *)memchr(p, '\n', e - p);
+			const char *next = nl ? nl + 1 : e;
+			size_t len = next - p;
+			while (len > 0 && (p[len-1] == '\n' || p[len-1] == '\r')) len--;
+			bool skip = false;
+			if (!ignore.empty()) {
+				const char *q = p;
+				while (q < p + len && *q == ' ') q++;
+				const char *sp = (const char *)memchr(q, ' ', p + len - q);
+				skip = sp && sp + 1 < p + len && sp[1] == '"' && ignore.count(std::string(q, sp - q));
+			}
+			if (!skip) lines.push_back({p, len});
+			p = next;
+		}
+	}
+	return lines;
+}
+
+uint64_t diffHash(const std::vector<line_t> &lines) {
+	Hash64 h;
+	for (const line_t &l : lines) {
+		h.add(l.p, l.len);
+		h.add(DSXNEWLINE, 2);
+	}
+	return h.value();
+}
+
+/*
+ * Shortest edit script from a to b, ' ' keep, '-' delete, '+' insert: Myers in linear
+ * space. Common head and tail are kept, the middle snake of the rest (the snake
+ * where a forward and a backward search meet, half the edits each side) splits it
+ * in two, done the same way. O((N+M)D) time, O(N+M) memory.
+ */
+class EditScript {
+	private:
+	const std::vector<line_t> &mA, &mB;
+	std::vector<char> mOps;
+
+	bool eq(int x, int y) { return mA[x].len == mB[y].len && 0 == memcmp(mA[x].p, mB[y].p, mA[x].len); }
+
+	// middle snake of a[a0, a0+n), b[b0, b0+m), both not empty: (x, y) to (u, v),
+	// relative to a0, b0
+	void middle(int a0, int n, int b0, int m, int &x0, int &y0, int &u0, int &v0) {
+		int max = (n + m + 1) / 2, delta = n - m, off = max + 1;
+		bool odd = (delta & 1) != 0;
+		std::vector<int> vf(2 * max + 3, 0), vb(2 * max + 3, 0);
+		for (int d = 0; d <= max; d++) {
+			for (int k = -d; k <= d; k += 2) {
+				int x = (k == -d || (k != d && vf[off + k - 1] < vf[off + k + 1])) ? vf[off + k + 1] : vf[off + k - 1] + 1;
+				int y = x - k, sx = x, sy = y;
+				while (x < n && y < m && eq(a0 + x, b0 + y)) { x++; y++; }
+				vf[off + k] = x;
+				// meets a backward path of d - 1 edits
+				if (odd && delta - k >= -(d - 1) && delta - k <= d - 1 && x + vb[off + delta - k] >= n) {
+					x0 = sx; y0 = sy; u0 = x; v0 = y;
+					return;
+				}
+			}
+			for (int k = -d; k <= d; k += 2) {
+				int x = (k == -d || (k != d && vb[off + k - 1] < vb[off + k + 1])) ? vb[off + k + 1] : vb[off + k - 1] + 1;
+				int y = x - k, sx = x, sy = y;
+				while (x < n && y < m && eq(a0 + n - 1 - x, b0 + m - 1 - y)) { x++; y++; }
+				vb[off + k] = x;
+				// meets a forward path of d edits
+				if (!odd && delta - k >= -d && delta - k <= d && x + vf[off + delta - k] >= n) {
+					x0 = n - x; y0 = m - y; u0 = n - sx; v0 = m - sy;
+					return;
+				}
+			}
+		}
+		x0 = u0 = n; y0 = v0 = m;	// not reached
+	}
+
+	void run(int a0, int a1, int b0, int b1) {
+		for (; a0 < a1 && b0 < b1 && eq(a0, b0); a0++, b0++) mOps.push_back(' ');
+		int tail = 0;
+		for (; a1 > a0 && b1 > b0 && eq(a1 - 1, b1 - 1); a1--, b1--) tail++;
+		if (a0 == a1) {
+			mOps.insert(mOps.end(), b1 - b0, '+');
+		} else if (b0 == b1) {
+			mOps.insert(mOps.end(), a1 - a0, '-');
+		} else {
+			// no common head or tail: 2 edits or more, each half has fewer
+			int x, y, u, v;
+			middle(a0, a1 - a0, b0, b1 - b0, x, y, u, v);
+			run(a0, a0 + x, b0, b0 + y);
+			mOps.insert(mOps.end(), u - x, ' ');
+			run(a0 + u, a1, b0 + v, b1);
+		}
+		mOps.insert(mOps.end(), tail, ' ');
+	}
+
+	public:
+	EditScript(const std::vector<line_t> &a, const std::vector<line_t> &b) : mA(a), mB(b) {}
+	std::vector<char> ops() {
+		mOps.clear();
+		mOps.reserve(mA.size() + mB.size());
+		run(0, mA.size(), 0, mB.size());
+		return mOps;
+	}
+}; // class EditScript
+
+std::vector<char> editScript(const std::vector<line_t> &a, const std::vector<line_t> &b) {
+	return EditScript(a, b).ops();
+}
+
+#define DIFF_CONTEXT 3
+void unifiedDiff(const std::vector<line_t> &a, const std::vector<line_t> &b, const std::string &nameA, const std::string &nameB, std::ostream &out) {
+	std::vector<char> ops = editScript(a, b);
+	out << "--- " << nameA << std::endl << "+++ " << nameB << std::endl;
+	// hunks: changes with up to DIFF_CONTEXT unchanged lines around, closer ones merged
+	size_t i = 0, ia = 0, ib = 0;
+	while (i < ops.size()) {
+		if (ops[i] == ' ') { i++; ia++; ib++; continue; }
+		size_t start = i >= DIFF_CONTEXT ? i - DIFF_CONTEXT : 0;
+		for (; start < i && ops[start] != ' '; start++) ;
+		size_t sa = ia - (i - start), sb = ib - (i - start);
+		size_t end = i, keep = 0;
+		for (; end < ops.size(); end++) {
+			if (ops[end] != ' ') keep = 0;
+			else if (++keep > 2 * DIFF_CONTEXT) break;
+		}
+		end -= (keep > DIFF_CONTEXT ? keep - DIFF_CONTEXT : 0);
+		size_t na = 0, nb = 0;
+		for (size_t j = start; j < end; j++) {
+			if (ops[j] != '+') na++;
+			if (ops[j] != '-') nb++;
+		}
+		out << string_format("@@ -%lu,%lu +%lu,%lu @@", (unsigned long)(na ? sa + 1 : sa), (unsigned long)na,
+			(unsigned long)(nb ? sb + 1 : sb), (unsigned long)nb) << std::endl;
+		size_t xa = sa, xb = sb;
+		for (size_t j = start; j < end; j++) {
+			const line_t &l = ops[j] == '+' ? b[xb] : a[xa];
+			out << ops[j];
+			out.write(l.p, l.len);
+			out << std::endl;
+			if (ops[j] != '+') xa++;
+			if (ops[j] != '-') xb++;
+		}
+		for (; i < end; i++) {
+			if (ops[i] != '+') ia++;
+			if (ops[i] != '-') ib++;
+		}
+	}
+}
+
+int diffFiles(const std::string &fileA, const std::string &fileB, po::variables_map &vm) {
+	std::set<std::string> ignore;
+	if (vm.count("diff-ignore"))
+		for (const std::string &a : vm["diff-ignore"].as<std::vector<std::string> >()) ignore.insert(a);
+	bool unified = vm["unified"].as<bool>();
+	std::vector<std::string> none;
+	auto selection = [&]() {
+		return new Selection(vm.count("only") ? vm["only"].as<std::vector<std::string> >() : none,
+			vm.count("type") ? vm["type"].as<std::vector<std::string> >() : none,
+			vm.count("category") ? vm["category"].as<std::vector<std::string> >() : none);
+	};
+	std::unique_ptr<Selection> selA(selection()), selB(selection());
+	for (const std::string &f : {fileA, fileB})
+		if (isGzipFile(f) || isXmlFile(f)) {
+			std::cerr << "Error: --diff of a gzip or XML file [" << f << "], two .dsx are needed" << std::endl;
+			return -1;
+		}
+
+	// both parsed at once
+	Collection a(fileA.c_str()), b(fileB.c_str());
+	a.select(selA.get());
+	b.select(selB.get());
+	a.handle(comp_table.get());
+	b.handle(comp_table.get());
+	a.stripBinaries(b_oStripBinaries);
+	b.stripBinaries(b_oStripBinaries);
+	auto load = [](Collection *c) {
+		if (!(b_oNoMmap ? c->readFile() : c->mapFile())) return false;
+		c->parse(n_oParseJobs);
+		return true;
+	};
+	std::future<bool> loadA = std::async(std::launch::async, load, &a);
+	bool okB = load(&b), okA = loadA.get();
+	if (!okA || !okB) {
+		std::cerr << "Error in read file [" << (okA ? fileB : fileA) << "]. Quit" << std::endl;
+		return -1;
+	}
+
+	auto key = [](Component *c) { return c->getType() + '\0' + c->getCate() + '\0' + c->getName(); };
+	std::map<std::string, Component*> inB;
+	for (Component *c : b.getComponents()) inB[key(c)] = c;
+	int nAdded = 0, nRemoved = 0, nChanged = 0, nSame = 0;
+	auto print = [](char tag, Component *c) {
+		std::cout << tag << string_format("  %-18s", c->getType().c_str()) << string_format("  %-28s", c->getPath().c_str())
+			<< string_format("  %-28s", c->getName().c_str()) << std::endl;
+	};
+	std::set<std::string> matched;
+	for (Component *ca : a.getComponents()) {
+		std::string k = key(ca);
+		auto it = inB.find(k);
+		if (it == inB.end()) {
+			print('-', ca);
+			nRemoved++;
+			continue;
+		}
+		matched.insert(k);
+		Component *cb = it->second;
+		std::vector<line_t> la, lb;
+		bool same;
+		if (ignore.empty()) {
+			same = ca->contentSize() == cb->contentSize() && ca->getHash() == cb->getHash();
+		} else {
+			la = diffLines(ca, ignore);
+			lb = diffLines(cb, ignore);
+			same = diffHash(la) == diffHash(lb);
+		}
+		if (same) {
+			nSame++;
+			continue;
+		}
+		print('M', ca);
+		nChanged++;
+		if (unified) {
+			if (ignore.empty()) {
+				la = diffLines(ca, ignore);
+				lb = diffLines(cb, ignore);
+			}
+			std::string rel = ca->getPath() + Component::getDirSeptChar() + ca->getName() + ".dsx";
+			unifiedDiff(la, lb, fileA + ":" + rel, fileB + ":" + rel, std::cout);
+		}
+	}
+	for (Component *cb : b.getComponents()) {
+		if (matched.count(key(cb))) continue;
+		print('+', cb);
+		nAdded++;
+	}
+	if (!b_oQuiet) {
+		std::cout << std::endl << string_format("%d added, %d removed, %d changed, %d same", nAdded, nRemoved, nChanged, nSame) << std::endl;
+	}
+	return (nAdded || nRemoved || nChanged) ? 1 : 0;
+}
+
+// stream(read) into pool: the components of coll are written under targetDIR as their
+// END line is read. Return number of components.
+int streamComponents(Collection &coll, std::function<size_t(char *, size_t)> read, WritePool &pool, const std::string &targetDIR, Manifest *mf) {
+	int n = 1;
+	coll.stream(read,
+		[&](Component *c) {
+			if (coll.getHeader().size() == 0) throw string("**no header**");
+			// c is gone after return, writers get their own copy
+			std::shared_ptr<std::string> body = std::make_shared<std::string>(c->getBody());
+			span_t sp = {0, body->size()};
+			std::shared_ptr<Component> cc = std::make_shared<Component>(body->data(), sp, c->getType(), c->getName(), c->getCate(), coll.pool());
+			int i = n++;
+			pool.submit([&coll, &targetDIR, body, cc, i, mf]() { return writeComponent(coll, cc.get(), targetDIR, i, 0, mf); });
+		});
+	return n - 1;
+}
+
+/*
+ * Split inputs, the writer threads shared by all. One input is parsed with all
+ * parser threads and written into targetDIR. Several are parsed --parse-jobs at a
+ * time, ahead of the writers, each written into a dir of targetDIR named after it;
+ * a component with the same type, category, name and body as in an earlier input of
+ * the same header is linked to the file of that one (dup_t). Text is printed in input order.
+ */
+int splitFiles(const std::vector<std::string> &inputs, const std::string &targetDIR, po::variables_map &vm) {
+	typedef struct {
+		std::unique_ptr<Collection> coll;
+		std::unique_ptr<Selection> sel;
+		std::unique_ptr<Manifest> mf;
+		std::string root;	// output dir
+		std::string msg;	// to print before the components
+		bool ok;
+		bool stream;		// over --memory-limit or gzip, stream() instead of parse()
+		bool gz;		// inflated while streamed
+	} input_t;
+
+	bool batch = inputs.size() > 1;
+	int nParse = n_oParseJobs ? n_oParseJobs : std::thread::hardware_concurrency();
+	if (nParse < 1 || n_oMemLimit > 0) nParse = 1;
+	std::vector<std::string> none;
+
+	auto load = [&](const std::string &file) {
+		std::shared_ptr<input_t> in = std::make_shared<input_t>();
+		std::ostringstream out;
+		in->ok = false;
+		in->stream = in->gz = false;
+		in->root = targetDIR;
+		if (batch) {
+			boost::filesystem::path stem = boost::filesystem::path(file).stem();
+			if (boost::filesystem::path(file).extension() == ".gz") stem = stem.stem();	// a.dsx.gz: a
+			in->root += Component::getDirSeptChar() + stem.string();
+			if (!b_oQuiet) out << std::endl << "DSX file: \t" << file << std::endl;
+		}
+		in->sel.reset(new Selection(vm.count("only") ? vm["only"].as<std::vector<std::string> >() : none,
+			vm.count("type") ? vm["type"].as<std::vector<std::string> >() : none,
+			vm.count("category") ? vm["category"].as<std::vector<std::string> >() : none));
+		Selection *psel = in->sel->empty() ? NULL : in->sel.get();
+
+		Collection *coll = new Collection(file.c_str());
+		in->coll.reset(coll);
+		coll->select(psel);
+		coll->handle(comp_table.get());
+		coll->stats(&run_stats);
+		coll->tar(tar_sink);
+		coll->stripBinaries(b_oStripBinaries);
+		bool closure = vm.count("closure") > 0;
+		if (closure && (isGzipFile(file) || isXmlFile(file))) {
+			out << "Error: --closure of a gzip or XML file [" << file << "], a .dsx is needed" << std::endl;
+			in->msg = out.str();
+			return in;
+		}
+		if (isGzipFile(file)) {
+#if ZLIB
+			if (!b_oQuiet) out << "gzip, inflated while streamed" << std::endl << std::endl;
+			in->msg = out.str();
+			in->ok = in->stream = in->gz = true;
+			if (b_oIncremental) in->mf.reset(new Manifest(in->root));
+#else
+			out << "Error: [" << file << "] is gzip compressed, not supported by this build (ZLIB=0)" << std::endl;
+			in->msg = out.str();
+#endif
+			return in;
+		}
+		if (isXmlFile(file)) {
+			if (!b_oQuiet) out << "XML export, streamed" << std::endl << std::endl;
+			in->msg = out.str();
+			in->ok = in->stream = true;
+			if (b_oIncremental) in->mf.reset(new Manifest(in->root));
+			return in;
+		}
+		// a closure needs all components, not streamed
+		if (!closure && n_oMemLimit > 0 && Collection::memoryNeeded(boost::filesystem::file_size(file)) > (size_t)n_oMemLimit << 20) {
+			if (!b_oQuiet) out << "Over --memory-limit, streamed" << std::endl << std::endl;
+			in->msg = out.str();
+			in->ok = in->stream = true;
+			if (b_oIncremental) in->mf.reset(new Manifest(in->root));
+			return in;
+		}
+		Stats::mark_t m = run_stats.mark();
+		bool read = b_oNoMmap ? coll->readFile() : coll->mapFile();
+		run_stats.add(Stats::READ, m);
+		if (!read) { //catch exceptions ...
+			if (!b_oQuiet) out << "Error in read file [" << file << "]. Quit" << std::endl;
+			in->msg = out.str();
+			return in;
+		}
+
+		// parse, or take it from the index
+		coll->copyRange(b_oCopyRange);
+		run_stats.bytesIn(coll->bytes());
+		m = run_stats.mark();
+		// the index has no holes, not used with --strip-binaries
+		bool index = b_oIndex && !b_oStripBinaries;
+		if (index && coll->loadIndex()) {
+			if (!b_oQuiet) out << "Index " << Collection::indexPath(file) << " used, not parsed" << std::endl << std::endl;
+		} else {
+			coll->parse(batch ? 1 : n_oParseJobs);
+			if (!b_oQuiet) {
+				out << string_format("Parsed %d components, %.1f MB in %.3fs (%.1f MB/s)",
+					coll->count(), coll->scanned() / (1024.0 * 1024.0), coll->parseSecs(), coll->parseMBps()) << std::endl << std::endl;
+			}
+			// a selection is not the whole file
+			if (index && !psel && coll->count() > 0 && !coll->writeIndex())
+				out << "Error: fail to write index " << Collection::indexPath(file) << std::endl;
+		}
+		if (closure) {
+			// diagnostics to stderr, stdout may be the .dsx (--closure-dsx -)
+			int n = coll->closure(vm["closure"].as<std::vector<std::string> >(), std::cerr);
+			if (n < 0) {
+				in->msg = out.str();
+				return in;
+			}
+			if (!b_oQuiet) out << "Closure: " << n << " components" << std::endl << std::endl;
+		}
+		run_stats.add(Stats::PARSE, m);
+		in->msg = out.str();
+		in->ok = true;
+		if (b_oIncremental) in->mf.reset(new Manifest(in->root));
+		return in;
+	};
+
+	WritePool pool(n_oJobs);
+	std::deque<std::future<std::shared_ptr<input_t> > > ahead;
+	std::vector<std::pair<size_t, std::shared_ptr<input_t> > > busy;	// last task of each, to free it after
+	std::vector<std::shared_ptr<input_t> > done;	// manifests, to finish after all writes
+	std::map<std::string, std::pair<size_t, std::shared_future<std::string> > > firsts;	// batch, by type, category, name, body and header hash
+	int rc = 0, nDup = 0, nComp = 0;
+
+	for (size_t k = 0; k < inputs.size(); k++) {
+		while (ahead.size() < (size_t)nParse && k + ahead.size() < inputs.size())
+			ahead.push_back(std::async(std::launch::async, load, inputs[k + ahead.size()]));
+		std::shared_ptr<input_t> in = ahead.front().get();
+		ahead.pop_front();
+
+		std::string msg = in->msg;
+		pool.submit([msg]() { return msg; });
+		if (!in->ok) {
+			rc = -1;
+			continue;
+		}
+		Collection &coll = *in->coll;
+		Selection *psel = in->sel->empty() ? NULL : in->sel.get();
+		if (in->stream) {
+			FILE *fp = fopen(inputs[k].c_str(), "rb");
+			if (fp == NULL) {
+				pool.submit([]() { std::cerr << "Error in read file. Quit" << std::endl; return std::string(); });
+				rc = -1;
+				continue;
+			}
+			Stats::mark_t m = run_stats.mark();
+			int N;
+			bool err;
+#if ZLIB
+			if (in->gz) {
+				GzReader gz;
+				if (gz.open(dup(fileno(fp)))) {
+					N = streamComponents(coll, [&gz](char *buf, size_t size) { return gz.read(buf, size); }, pool, in->root, in->mf.get());
+					err = gz.error();
+				} else {
+					N = 0;
+					err = true;
+				}
+			} else
+#endif
+			{
+				N = streamComponents(coll, [fp](char *buf, size_t size) { return fread(buf, 1, size, fp); }, pool, in->root, in->mf.get());
+				err = ferror(fp);
+			}
+			run_stats.add(Stats::PARSE, m);
+			run_stats.bytesIn(coll.bytes());
+			fclose(fp);
+			if (coll.incomplete()) rc = -1;
+			if (err) {
+				pool.submit([]() { std::cerr << "Error in read file. Quit" << std::endl; return std::string(); });
+				rc = -1;
+			}
+			if (N == 0) pool.submit([]() { std::cerr << "** no component found in file**"<< std::endl; return std::string(); });
+			nComp += N;
+			busy.push_back(std::make_pair(pool.submitted(), in));
+			done.push_back(in);
+			continue;
+		}
+		if (coll.incomplete()) rc = -1;	// the components before it are written
+		int N = coll.count();
+		if (N == 0) {
+			pool.submit([]() { std::cerr << "** no component found in file**"<< std::endl; return std::string(); });
+			pool.submit([psel]() { reportPending(psel); return std::string(); });
+			continue;
+		} else if (coll.getHeader().size() == 0) {
+			pool.submit([]() { std::cerr << "**no header**" << std::endl; return std::string(); });
+			rc = -1;
+			continue;
+		}
+
+		if (vm.count("closure-dsx") && !b_oList) {
+			// one .dsx, composed
+			std::string file = vm["closure-dsx"].as<std::string>();
+			pool.submit([&coll, file, N]() {
+				Stats::mark_t m = run_stats.mark(true);
+				int n = coll.composeToFile("", file);
+				run_stats.add(Stats::WRITE, m, true);
+				if (n < 0) {
+					run_stats.writeError();
+					return "Error: fail to write " + file + "\n";
+				}
+				return b_oQuiet ? std::string() : string_format("Composed %d components into %s\n", n, file.c_str());
+			});
+			nComp += N;
+			busy.push_back(std::make_pair(pool.submitted(), in));
+			done.push_back(in);
+			continue;
+		}
+
+		int n=1;
+		Manifest *m = in->mf.get();
+		const std::string &root = in->root;
+		// the files start with the header of their input: shared only by inputs with the same
+		Hash64 hh;
+		hh.add(coll.header().data(), coll.header().size());
+		std::string header = string_format("%016llx", (unsigned long long)hh.value());
+		// iterate the items.
+		for(Component* c : coll.getComponents()) {
+			dup_t dup, *pdup = NULL;
+			if (batch && !b_oList && !tar_sink) {
+				std::string key = c->getType() + '\0' + c->getCate() + '\0' + c->getName() + '\0' + string_format("%016llx", (unsigned long long)c->getHash()) + '\0' + header;
+				auto it = firsts.find(key);
+				if (it == firsts.end()) {
+					dup.mine = std::make_shared<std::promise<std::string> >();
+					dup.first = dup.mine->get_future().share();
+					firsts[key] = std::make_pair(k, dup.first);
+					pdup = &dup;
+				} else if (it->second.first != k) {	// same file twice in one input is just written
+					dup.first = it->second.second;
+					pdup = &dup;
+					nDup++;
+				}
+			}
+			pool.submit([&coll, &root, c, n, N, m, dup, pdup]() mutable {
+				return writeComponent(coll, c, root, n, N, m, pdup ? &dup : NULL);
+			});
+			n++;
+		}
+		nComp += N;
+		busy.push_back(std::make_pair(pool.submitted(), in));
+		done.push_back(in);
+
+		// collections of inputs written completely are not needed any more
+		size_t printed = pool.printed();
+		for (auto &b : busy)
+			if (b.second && b.first <= printed) b.second->coll.reset();
+	}
+	pool.finish();
+	for (auto &in : done) {
+		finishManifest(in->mf.get(), in->sel->empty() ? NULL : in->sel.get());
+		reportPending(in->sel->empty() ? NULL : in->sel.get());
+	}
+	if (batch && !b_oQuiet) {
+		std::cout << std::endl << string_format("%d inputs, %d components, %d written once for several inputs (linked)",
+			(int)inputs.size(), nComp, nDup) << std::endl;
+	}
+	return rc;
+}
+
+// end of a run writing to path (tree, archive or file): a non-zero exit if a file
+// was not written, and what was written flushed to disk, once for all (--no-sync)
+int finishOutput(const std::string &path, int rc) {
+	if (run_stats.writeErrors() > 0) {
+		std::cerr << "Error: " << run_stats.writeErrors() << " files not written" << std::endl;
+		rc = -1;
+	}
+	if (b_oList || b_oNoSync || path == "-") return rc;
+	Stats::mark_t m = run_stats.mark();
+	if (!syncOutput(path)) {
+		std::cerr << "Error: fail to flush " << path << " to disk" << std::endl;
+		rc = -1;
+	}
+	run_stats.add(Stats::WRITE, m);
+	return rc;
+}
+
+// --stats report, to --stats-out or stderr
+void reportStats(po::variables_map &vm) {
+	if (!run_stats.on) return;
+	if (vm.count("stats-out")) {
+		std::ofstream out(vm["stats-out"].as<std::string>());
+		run_stats.report(vm["stats"].as<std::string>(), out);
+		if (!out) std::cerr << "Error: fail to write " << vm["stats-out"].as<std::string>() << std::endl;
+	} else {
+		run_stats.report(vm["stats"].as<std::string>(), std::cerr);
+	}
+}
+
 int main(int argc, char ** argv) {
 
 	std::exception_ptr eptr;
+	comp_table.reset(new CompTypeTable());
 
 	try {
 	
@@ -745,12 +1676,41 @@ int main(int argc, char ** argv) {
 	
 		try {
 			desc.add_options()
-				("file,f", po::value<std::string>(), "REQUIED. Input .dsx file")
+				("file,f", po::value<std::vector<std::string> >()->composing(), "REQUIED. Input .dsx file, repeatable (* and ? in name)")
+				("file-list", po::value<std::string>(), "Input .dsx files listed in this file, one per line")
 				("list,l", po::bool_switch(&b_oList), "List components only (No write)")
 				("quiet,q", po::bool_switch(&b_oQuiet), "Suppress output(quiet)")
 		
 				("outdir,o", po::value<std::string>()->composing()->default_value("."), "Output dir (Default: current working directory)")
-				//("stdin,c", po::bool_switch(&b_oStdin), "DSX file content from stdin")
+				("stdin,c", po::bool_switch(&b_oStdin), "DSX file content from stdin, streamed")
+				("no-mmap", po::bool_switch(&b_oNoMmap), "Read input into memory instead of mapping it")
+				("copy-range", po::bool_switch(&b_oCopyRange), "Copy bodies from input to output file in the kernel (Linux)")
+				("no-sync", po::bool_switch(&b_oNoSync), "Don't flush the files written to disk at the end (scratch output)")
+				("incremental,i", po::bool_switch(&b_oIncremental), "Write only new or changed components")
+				("prune", po::bool_switch(&b_oPrune), "With -i, remove files of components gone since last run")
+				("index", po::bool_switch(&b_oIndex), "Use <file>.dsxidx instead of parsing, (re)write it when not valid")
+				("only", po::value<std::vector<std::string> >()->composing(), "Only components of this name (pattern, * and ?), repeatable")
+				("type", po::value<std::vector<std::string> >()->composing(), "Only components of this type, e.g. DSJOB or JOB (pattern), repeatable")
+				("category", po::value<std::vector<std::string> >()->composing(), "Only components in this category, \\\\Jobs\\\\* or as path (pattern), repeatable")
+				("strip-binaries", po::bool_switch(&b_oStripBinaries), "Leave compiled job executables (DSEXECJOB) and binaries (DSBPBINARY) out")
+				("types", po::value<std::vector<std::string> >()->composing(), "Types handled, others skipped unread, e.g. JOB,PS,RT,TD (default: all but DT,TD)")
+				("closure", po::value<std::vector<std::string> >()->composing(), "Only this component (pattern) and the parameter sets, routines and shared containers it uses, repeatable")
+				("closure-dsx", po::value<std::string>(), "With --closure, write them as one .dsx to this file (- for stdout), not a tree")
+				("tar", po::bool_switch(), "Write the files into one tar archive, -o <file> (- for stdout), not a tree")
+				("gzip,z", po::bool_switch(), "With --tar, gzip compressed (default for -o *.gz, *.tgz)")
+				("compose", po::value<std::string>(), "Compose one .dsx from a split tree, to -o <file> (- for stdout)")
+				("diff", po::bool_switch(), "List components added, removed or changed from the 1st to the 2nd file, no write")
+				("diff-ignore", po::value<std::vector<std::string> >()->composing(), "With --diff, attribute not compared, e.g. DateModified, repeatable")
+				("unified,u", po::bool_switch(), "With --diff, unified diff of each changed component")
+				("gen-synthetic", po::value<std::string>(), "Write a synthetic .dsx to this file, see --gen-spec")
+				("gen-spec", po::value<std::string>()->default_value("jobs=1000,routines=200,paramsets=20,body=4096,depth=3,seed=1"), "Size of --gen-synthetic output")
+				("bench", po::value<std::string>(), "Time read, parse, pack and write of this .dsx (best of 3), into -o")
+				("bench-out", po::value<std::string>()->default_value("dsxcut-bench.jsonl"), "--bench results appended to this file, a JSON line per run")
+				("stats", po::value<std::string>()->implicit_value("text"), "Report phase times, bytes, counts and peak RSS to stderr, --stats=json as JSON")
+				("stats-out", po::value<std::string>(), "--stats report to this file instead")
+				("memory-limit", po::value<int>(&n_oMemLimit)->default_value(0), "MB, stream inputs that would need more (0: no limit)")
+				("jobs,j", po::value<int>(&n_oJobs)->default_value(1), "Writer threads")
+				("parse-jobs", po::value<int>(&n_oParseJobs)->default_value(0), "Parser threads (0: one per core)")
 				("help,h", "This help msg")
 				;
 		
@@ -784,14 +1744,35 @@ int main(int argc, char ** argv) {
 		
 			// validations
 			if (DEBUG) std::cout << "=========validation==============" << std::endl;
-			if (!vm.count("file")  && b_oStdin == false ) {
+			if (vm.count("stats")) {
+				// "--stats a.dsx" takes a.dsx as the format
+				if (vm["stats"].as<std::string>() != "text" && vm["stats"].as<std::string>() != "json")
+					throw string("Error: --stats is text or json, --stats=json; before an input file --stats=text");
+				run_stats.on = true;
+			}
+			if (vm.count("closure")) {
+				if (vm.count("only") || vm.count("type") || vm.count("category"))
+					throw string("Error: --closure does not go with --only, --type or --category");
+				if (b_oStdin) throw string("Error: --closure needs an input file, not -c");
+			} else if (vm.count("closure-dsx")) {
+				throw string("Error: --closure-dsx needs --closure");
+			}
+			if (vm.count("types")) {
+				std::string bad = comp_table->select(vm["types"].as<std::vector<std::string> >());
+				if (!bad.empty())
+					throw string("Error: --types " + bad + " unknown, one of HD JOB DT PS TD RT TR ST SC");
+			}
+			if (vm.count("compose") || vm.count("gen-synthetic") || vm.count("bench")) {
+				// no input file, -o is the output file or dir
+			} else if (!vm.count("file") && !vm.count("file-list") && b_oStdin == false ) {
 				std::cout << "Error: input file must be provided!" << std::endl;
 				usage(argc,argv);
 				return 1;
 			}
 			//if (!b_oQuiet) std::cout << "file = " << vm["file"].as<std::string>() << std::endl;
 		
-			po_validate(argc, argv, vm);
+			if (vm.count("bench")) po_validate_target(argc, argv, vm);
+			else if (!vm.count("compose") && !vm.count("gen-synthetic")) po_validate(argc, argv, vm);
 		
 		
 		
@@ -810,6 +1791,18 @@ int main(int argc, char ** argv) {
 	
 		// validate in/out fs environment.
 		//fs_env(argc, argv);
+
+		if (vm.count("compose")) {
+			if (vm["outdir"].defaulted()) {
+				std::cout << "Error: --compose needs -o <file> (- for stdout)" << std::endl;
+				usage(argc, argv);
+				return 1;
+			}
+			std::string outFile = vm["outdir"].as<std::string>();
+			int rc = composeTree(vm["compose"].as<std::string>(), outFile, n_oParseJobs);
+			return rc == 0 ? finishOutput(outFile, rc) : rc;
+		}
+		if (vm.count("gen-synthetic")) return genSynthetic(vm["gen-synthetic"].as<std::string>(), vm["gen-spec"].as<std::string>());
 	
 		// target dir
 		std::string cwd = boost::filesystem::current_path().string();
@@ -822,9 +1815,73 @@ int main(int argc, char ** argv) {
 	
 		//std::cout << "b_oQuiet="<<b_oQuiet << endl;
 		//std::cout << "b_oList="<<b_oList << endl;
+		if (vm.count("bench")) return benchFile(vm["bench"].as<std::string>(), targetDIR, vm["bench-out"].as<std::string>());
+
+		std::vector<std::string> inputs;
+		if (!b_oStdin) inputs = inputFiles(vm);
+		if (vm["diff"].as<bool>()) {
+			if (inputs.size() != 2) {
+				std::cout << "Error: --diff needs two input files" << std::endl;
+				usage(argc, argv);
+				return -1;
+			}
+			return diffFiles(inputs[0], inputs[1], vm);
+		}
+
+		if (vm.count("closure-dsx")) {
+			if (inputs.size() != 1) {
+				std::cout << "Error: --closure-dsx needs one input file" << std::endl;
+				usage(argc, argv);
+				return -1;
+			}
+			if (vm["closure-dsx"].as<std::string>() == "-") b_oQuiet = true;	// stdout is the .dsx
+		}
+
+		// one tar archive, -o, instead of the tree
+		std::unique_ptr<TarSink> tar;
+		std::string archive = vm["outdir"].as<std::string>();
+		if (vm["tar"].as<bool>() && !b_oList) {
+			if (vm["outdir"].defaulted()) {
+				std::cout << "Error: --tar needs -o <file> (- for stdout)" << std::endl;
+				usage(argc, argv);
+				return 1;
+			}
+			bool gzip = vm["gzip"].as<bool>() ||
+				(archive.size() > 3 && archive.compare(archive.size() - 3, 3, ".gz") == 0) ||
+				(archive.size() > 4 && archive.compare(archive.size() - 4, 4, ".tgz") == 0);
+			int fd = -1;
+			if (archive == "-") {
+				// the archive gets stdout, text goes to stderr
+				fflush(stdout);
+				fd = dup(1);
+				dup2(2, 1);
+#ifdef _WIN32
+				_setmode(fd, _O_BINARY);
+#endif
+			}
+			tar.reset(new TarSink());
+			if (!tar->open(archive, gzip, fd)) {
+				std::cerr << "Error: can't create " << archive << std::endl;
+				return -1;
+			}
+			tar_sink = tar.get();
+			targetDIR = "";
+			n_oJobs = 1;	// entries in order
+			if (b_oIncremental) {
+				std::cerr << "Warning: -i is ignored with --tar" << std::endl;
+				b_oIncremental = false;
+			}
+		}
+		// what is written: the tree, or one file
+		std::string output = vm.count("closure-dsx") ? vm["closure-dsx"].as<std::string>() : tar_sink ? archive : targetDIR;
 		if (!b_oQuiet) {
-			std::cout << "DSX file: \t"<< vm["file"].as<std::string>() << std::endl;
-			std::cout << "output DIR:\t"<< targetDIR << std::endl;
+			if (inputs.size() > 1)
+				std::cout << "DSX files: \t"<< inputs.size() << std::endl;
+			else
+				std::cout << "DSX file: \t"<< (b_oStdin ? "<stdin>" : inputs[0]) << std::endl;
+			if (vm.count("closure-dsx")) std::cout << "output file:\t"<< vm["closure-dsx"].as<std::string>() << std::endl;
+			else if (tar_sink) std::cout << "output tar:\t"<< archive << std::endl;
+			else std::cout << "output DIR:\t"<< targetDIR << std::endl;
 			if (b_oList) std::cout << "**LIST ONLY**" << std::endl;
 
 			std::cout << std::endl;
@@ -832,62 +1889,71 @@ int main(int argc, char ** argv) {
 	
 	
 	
-		// get .dsx file
-		//Collection coll = Collection(argv[1]);
-		Collection coll = Collection(vm["file"].as<std::string>().c_str());
-		if (! coll.readFile()) { //catch exceptions ...
+		Selection sel(vm.count("only") ? vm["only"].as<std::vector<std::string> >() : std::vector<std::string>(),
+			vm.count("type") ? vm["type"].as<std::vector<std::string> >() : std::vector<std::string>(),
+			vm.count("category") ? vm["category"].as<std::vector<std::string> >() : std::vector<std::string>());
+		Selection *psel = sel.empty() ? NULL : &sel;
+
+		if (b_oStdin) {
+#ifdef _WIN32
+			_setmode(_fileno(stdin), _O_BINARY);
+#endif
+			// split while reading, components are written as they arrive
+			Collection coll;
+			coll.select(psel);
+			coll.handle(comp_table.get());
+			coll.stats(&run_stats);
+			coll.tar(tar_sink);
+			coll.stripBinaries(b_oStripBinaries);
+			std::unique_ptr<Manifest> mf(b_oIncremental ? new Manifest(targetDIR) : NULL);
+			WritePool pool(n_oJobs);
+			// read and parse are one phase, writers waited for included
+			Stats::mark_t m = run_stats.mark();
+			int n = 1;
+			bool err;
+#if ZLIB
+			// gzip or not, zlib passes plain input through
+			GzReader gz;
+			if (gz.open(dup(fileno(stdin)))) {
+				n += streamComponents(coll, [&gz](char *buf, size_t size) { return gz.read(buf, size); }, pool, targetDIR, mf.get());
+				err = gz.error();
+			} else
+				err = true;
+#else
+			n += streamComponents(coll, [](char *buf, size_t size) { return fread(buf, 1, size, stdin); }, pool, targetDIR, mf.get());
+			err = ferror(stdin);
+#endif
+			run_stats.add(Stats::PARSE, m);
+			run_stats.bytesIn(coll.bytes());
+			pool.finish();
+			finishManifest(mf.get(), psel);
+			reportPending(psel);
+			if (tar_sink && !tar_sink->finish()) {
+				std::cerr << "Error: fail to write " << archive << std::endl;
+				return -1;
+			}
+			int rc = finishOutput(output, coll.incomplete() ? -1 : 0);
+			reportStats(vm);
+			if (err) {
+				std::cerr << "Error in read stdin. Quit" << std::endl;
+				return -1;
+			}
 			if (!b_oQuiet) {
-				std::cout << "Error in read file [" << vm["file"].as<std::string>() << "]. Quit" << std::endl;
+				std::cout << std::endl << string_format("Streamed %d components, %.1f MB in %.3fs (%.1f MB/s)",
+					n - 1, coll.bytes() / (1024.0 * 1024.0), coll.parseSecs(), coll.parseMBps()) << std::endl;
 			}
-			return -1;
+			if (n == 1) std::cerr << "** no component found in file**"<< std::endl;
+			return rc;
 		}
-	
-		// parse
-		coll.parse();
-
 
-		int N = coll.count();
-		if (N == 0) {
-			std::cerr << "** no component found in file**"<< std::endl;
-			return 0;
-		} else if (coll.getHeader().size() == 0) {
-			cerr << "**no header**" << endl;
-			throw("file has no header");
-		}
-
-		int n=1;
-		// iterate the items.
-		for(Component* c : coll.getComponents()) {
-			std::string fileContent = coll.pack0(c);
-			std::string FullPath;
-			std::string rPath = c->getPath();
-			FullPath = targetDIR + rPath;
-	
-			//std::cout <<"rPATH=["<< rPath <<"]" <<std::endl;
-			if (!b_oQuiet) {
-				string _name = c->getName();
-				string _path = c->getPath();
-				string _type = c->getType();
-				string _n = string_format("[%03d/%03d]", n, N);
-	
-				std::cout << _n <<
-					string_format("  %-18s" , _type.c_str()) <<
-					string_format("  %-28s" , _path.c_str()) <<
-					string_format("  %-28s", _name.c_str()) << std::endl;
-			}
-	
-			// write individual file
-			if (!b_oList &&  !coll.writeFile(FullPath, c->getName(), fileContent)) {
-				std::cout << "Error: fail to write file [" <<FullPath << Component::getDirSeptChar() << c->getName() << "]" << std::endl;
-				
-			}
-	
-			//std::cout << "writeFile '" << c->getName() <<"' to [" << FullPath << "] ... " << ((ret.size() > 0)? "OK":"Failed") << std::endl;
-	
-			
-			n++;
-	
+		int rc = splitFiles(inputs, targetDIR, vm);
+		if (tar_sink && !tar_sink->finish()) {
+			std::cerr << "Error: fail to write " << archive << std::endl;
+			rc = -1;
 		}
+		rc = finishOutput(output, rc);
+		reportStats(vm);
+		return rc;
 
 	} catch( char * msg) {
 		std::cerr << msg << std::endl;
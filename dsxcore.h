@@ -0,0 +1,2717 @@
+
+/*
+
+Copyright (C) 2023, Steve Jin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * dsxcore.h
+ *
+ * The parser, components and writers of dsxcut (DsxScanner, XmlScanner, Component,
+ * Collection, ...), shared by the library (dsxcut.cpp) and the command line (ct.cpp).
+ * Internal, it changes with the program: code using the library includes dsxcut.h.
+ * All in namespace dsxcore; the few globals declared here, read-only once initialised,
+ * are defined in dsxcut.cpp. What a run changes (types handled, stats, tar output) is
+ * set on each Collection.
+ */
+
+#ifndef DSXCORE_H
+#define DSXCORE_H
+
+#ifndef ZLIB
+#define ZLIB 1		// gzip for --tar and input, link with -lz; build with -DZLIB=0 without
+#endif
+#ifndef DSXCORE_DEBUG
+#define DSXCORE_DEBUG 0	// trace of the parse to stdout
+#endif
+
+
+#include <string>
+#include <iostream>
+
+#include <sys/types.h>
+#include <sys/stat.h>	// stat()
+
+#include <fstream>
+#include <streambuf>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <chrono>	// parse throughput
+#include <functional>
+#include <sstream>
+#include <memory>
+#include <deque>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <thread>	// writer threads
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>	// std::rename()
+#include <ctime>
+//#include <filesystem>	// create_directoryies(), cwd()
+
+
+//#include <conio>	// getchar()
+
+#include <unistd.h>
+//#include <stacktrace>
+#ifndef _WIN32
+#include <fcntl.h>	// open()
+#include <sys/mman.h>	// mmap(), madvise()
+#include <sys/uio.h>	// writev()
+#include <sys/syscall.h>	// copy_file_range
+#include <sys/resource.h>	// getrusage()
+#include <limits.h>	// IOV_MAX
+#include <cerrno>
+#else
+#include <fcntl.h>	// _O_BINARY
+#include <io.h>		// _setmode()
+#include <process.h>	// _getpid()
+#endif
+
+//#include <boost/system>
+#include <boost/filesystem.hpp>
+#if ZLIB
+#include <zlib.h>
+#endif
+
+// SIMD marker search, x86 with gcc; from gcc 4.9 (target attribute with intrinsics)
+// also when not built for SSE2 (i686), and with AVX2
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+	(defined(__SSE2__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define DSX_SIMD 1
+#include <immintrin.h>
+#if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#define DSX_AVX2 1
+#endif
+#else
+#define DSX_SIMD 0
+#endif
+
+
+// all of it in dsxcore, std names included: nothing is added to the global namespace
+namespace dsxcore {
+
+using namespace std;
+
+
+
+
+template<typename ... Args>
+std::string string_format(const std::string & format, Args ... args) {
+	int size_s = std::snprintf(nullptr, 0, format.c_str(), args ...) +1;
+	if (size_s < 0) {throw std::runtime_error("Error in string_format()");}
+	auto size = static_cast <size_t>(size_s);
+	
+	std::unique_ptr<char[]> buf(new char[size]);
+	std::snprintf(buf.get(), size, format.c_str(), args ...);
+	return std::string(buf.get(), buf.get() + size -1);
+
+}
+
+// 64-bit non-cryptographic hash, fed in pieces of any size: 8-byte words, multiply
+// and rotate per word, murmur3 finalizer.
+class Hash64 {
+	private:
+	uint64_t mH;
+	uint64_t mLen;
+	unsigned char mTail[8];
+	size_t mNTail;
+
+	static inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+	inline void word(uint64_t w) {
+		mH ^= rotl(w * 0x87c37b91114253d5ULL, 31) * 0x4cf5ad432745937fULL;
+		mH = rotl(mH, 27) * 5 + 0x52dce729;
+	}
+
+	public:
+	Hash64() : mH(0x9e3779b97f4a7c15ULL), mLen(0), mNTail(0) {}
+
+	void add(const char *p, size_t n) {
+		mLen += n;
+		while (mNTail > 0 && mNTail < 8 && n > 0) { mTail[mNTail++] = *p++; n--; }
+		if (mNTail == 8) {
+			uint64_t w;
+			memcpy(&w, mTail, 8);
+			word(w);
+			mNTail = 0;
+		}
+		for (; n >= 8; p += 8, n -= 8) {
+			uint64_t w;
+			memcpy(&w, p, 8);
+			word(w);
+		}
+		while (n > 0) { mTail[mNTail++] = *p++; n--; }
+	}
+	uint64_t value() {
+		uint64_t h = mH, w = 0;
+		memcpy(&w, mTail, mNTail);
+		h ^= rotl(w * 0x87c37b91114253d5ULL, 31) ^ mLen;
+		h ^= h >> 33; h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		return h;
+	}
+}; // class Hash64
+
+#define DSXNEWLINE "\x0d\x0a"
+typedef struct {
+	string type_short;
+	string type;
+	int entity_level;	// if 2, with 1st level seperator as "^   DSRECORD$".
+	int name_level;
+	int cate_level;
+	string name_prefix;
+	string cate_prefix;
+	bool on;		// handled unless --types says otherwise
+}comp_t;
+
+enum {
+	F_TYPE,
+	F_BSTART,
+	F_BEND,
+	F_LEVEL,
+	F_NSTART,
+	F_NEND,
+	F_NQUOTE
+};
+
+extern std::vector<comp_t> comp_types;	// the types known, in dsxcut.cpp
+
+
+
+/*
+ * A set of types, found by their BEGIN tag in one probe or two: open addressing on a
+ * hash of the tag bytes, no string built. The ones of comp_types with on set, or
+ * those of --types; HEADER always. A Collection handles the types of its table, a
+ * tag not in it is a block to skip; known() has them all, for what a type is.
+ */
+#define COMP_TABLE 64	// power of 2, over twice the number of types
+class CompTypeTable {
+	private:
+	const comp_t *mSlot[COMP_TABLE];
+	std::string mKey;	// types handled, short names in comp_types order
+
+	static size_t slot(const char *tag, size_t n) {
+		uint32_t h = 2166136261u;
+		for (size_t i = 0; i < n; i++) h = (h ^ (unsigned char)tag[i]) * 16777619u;
+		return h & (COMP_TABLE - 1);
+	}
+	void build(const std::vector<bool> &on) {
+		memset(mSlot, 0, sizeof(mSlot));
+		mKey.clear();
+		for (size_t k = 0; k < comp_types.size(); k++) {
+			if (!on[k]) continue;
+			const comp_t &ct = comp_types[k];
+			size_t i = slot(ct.type.data(), ct.type.size());
+			while (mSlot[i]) i = (i + 1) & (COMP_TABLE - 1);
+			mSlot[i] = &ct;
+			mKey += ct.type_short + ",";
+		}
+	}
+
+	public:
+	CompTypeTable() {
+		std::vector<bool> on;
+		for (const comp_t &ct : comp_types) on.push_back(ct.on);
+		build(on);
+	}
+	// --types: short or full names, comma separated; return the unknown one, empty if none
+	std::string select(const std::vector<std::string> &lists) {
+		std::vector<bool> on(comp_types.size(), false);
+		on[0] = true;	// HEADER
+		for (const std::string &list : lists) {
+			std::istringstream ss(list);
+			std::string name;
+			while (std::getline(ss, name, ',')) {
+				if (name.empty()) continue;
+				std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+				size_t k = 0;
+				while (k < comp_types.size() && comp_types[k].type_short != name && comp_types[k].type != name) k++;
+				if (k == comp_types.size()) return name;
+				on[k] = true;
+			}
+		}
+		build(on);
+		return "";
+	}
+	const comp_t * find(const char *tag, size_t n) const {
+		for (size_t i = slot(tag, n); mSlot[i]; i = (i + 1) & (COMP_TABLE - 1))
+			if (mSlot[i]->type.size() == n && 0 == memcmp(mSlot[i]->type.data(), tag, n)) return mSlot[i];
+		return NULL;
+	}
+	const comp_t * find(const std::string &type) const { return find(type.data(), type.size()); }
+	const std::string & key() const { return mKey; }
+
+	// built on first use, not before comp_types is
+	static const CompTypeTable & defaults() {
+		static const CompTypeTable t;
+		return t;
+	}
+	static const CompTypeTable & known() {
+		static const CompTypeTable t(std::vector<bool>(comp_types.size(), true));
+		return t;
+	}
+
+	private:
+	explicit CompTypeTable(const std::vector<bool> &on) { build(on); }
+}; // class CompTypeTable
+
+// any type known, handled or not
+inline const comp_t * findCompType(const char *tag, size_t n) {
+	return CompTypeTable::known().find(tag, n);
+}
+inline const comp_t * findCompType(const std::string &type) {
+	return CompTypeTable::known().find(type);
+}
+
+inline bool withCRLF(string str, size_t pos) {
+	if (0 == str.compare(pos, strlen(DSXNEWLINE), DSXNEWLINE))
+		return true;
+	return false;
+}
+
+inline bool skipCRLF(string str, size_t & pos) {
+	if (withCRLF(str, pos)) {
+		pos += strlen(DSXNEWLINE);
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
+/*
+ * DSX block scanner
+ *
+ * One forward pass over the buffer, line by line. DSX blocks nest by
+ * indentation, 3 spaces per level:
+ *
+ * 	BEGIN DSROUTINES		<- top level, entity_level 1 types live here
+ * 	   BEGIN DSRECORD		<- 2nd level, entity_level 2 types live here
+ * 	      BEGIN DSSUBRECORD
+ * 	      END DSSUBRECORD
+ * 	   END DSRECORD
+ * 	END DSROUTINES
+ *
+ * A block opens with "<indent>BEGIN <TAG>\r\n" and closes with "<indent>END <TAG>\r\n"
+ * at the same indent. Every pair at every depth is tracked on a stack, lines at any
+ * other indent (e.g. inside =+=+=+= values) are plain content.
+ * Closed top-level blocks are handed to the callback with the spans of their
+ * "   BEGIN DSRECORD" children, offsets relative to the start of the scanned buffer.
+ * With streamRecords(true) each DSRECORD is handed over as soon as it closes, in a
+ * block_t with closed == false, so a caller streaming the input can drop it.
+ * With want(f), a top-level block whose tag f refuses is not looked into: the scan
+ * jumps to its column 0 END line, the block is handed over without records.
+ * With strip(f), a sub-block whose tag f takes (a binary, e.g. DSEXECJOB) is skipped
+ * to its END line the same way and handed over as a hole of the block. With cut, the
+ * caller removes holes from its buffer instead, see cutFrom().
+ */
+typedef struct {
+	size_t ofs;
+	size_t len;
+} span_t;
+
+typedef struct {
+	string type;			// tag of top-level block, e.g. "DSJOB"
+	span_t body;			// "BEGIN X\r\n" ... "END X\r\n"
+	std::vector<span_t> records;	// "   BEGIN DSRECORD\r\n" ... "   END DSRECORD\r\n"
+	std::vector<span_t> holes;	// sub-blocks left out, see DsxScanner::strip()
+	bool closed;			// false: block still open, records handed over early
+} block_t;
+
+#define DSXINDENT 3
+
+// piece of an output file, in memory at p. srcOfs >= 0 if the same bytes are also
+// in the input file at that offset (body of a mapped input).
+typedef struct {
+	const char *p;
+	size_t len;
+	long long srcOfs;
+} piece_t;
+#define PARALLEL_MIN (4 << 20)	// smaller inputs are parsed serially
+#define PARALLEL_CHUNK 256	// components built per task
+
+/*
+ * Marker search: the next BEGIN/END line candidate, a "BE" or "EN" at p[i] with a
+ * line end (col0) or a line end or space (indented lines) before it. Lines without
+ * one are skipped whole, the scanner looks at the candidates only. Kernels for
+ * AVX2 and SSE2 compare 32/16 positions at once, one is picked for the CPU at start.
+ * p[from - 1] must be readable, from > 0. Return n when there is no candidate.
+ */
+typedef size_t (*marker_fn)(const char *p, size_t from, size_t n, bool col0);
+
+inline size_t markerScalar(const char *p, size_t from, size_t n, bool col0) {
+	for (size_t i = from; i + 1 < n; i++) {
+		if (((p[i] == 'B' && p[i+1] == 'E') || (p[i] == 'E' && p[i+1] == 'N')) &&
+			(p[i-1] == '\n' || (!col0 && p[i-1] == ' ')))
+			return i;
+	}
+	return n;
+}
+
+#if DSX_SIMD
+__attribute__((target("sse2")))
+inline size_t markerSSE2(const char *p, size_t from, size_t n, bool col0) {
+	const __m128i nl = _mm_set1_epi8('\n'), sp = _mm_set1_epi8(col0 ? '\n' : ' ');
+	const __m128i B = _mm_set1_epi8('B'), E = _mm_set1_epi8('E'), N = _mm_set1_epi8('N');
+	size_t i = from;
+	for (; i + 16 + 1 <= n; i += 16) {
+		__m128i prev = _mm_loadu_si128((const __m128i *)(p + i - 1));
+		__m128i cur = _mm_loadu_si128((const __m128i *)(p + i));
+		__m128i next = _mm_loadu_si128((const __m128i *)(p + i + 1));
+		__m128i lead = _mm_or_si128(_mm_cmpeq_epi8(prev, nl), _mm_cmpeq_epi8(prev, sp));
+		__m128i be = _mm_and_si128(_mm_cmpeq_epi8(cur, B), _mm_cmpeq_epi8(next, E));
+		__m128i en = _mm_and_si128(_mm_cmpeq_epi8(cur, E), _mm_cmpeq_epi8(next, N));
+		int mask = _mm_movemask_epi8(_mm_and_si128(lead, _mm_or_si128(be, en)));
+		if (mask) return i + __builtin_ctz(mask);
+	}
+	return markerScalar(p, i, n, col0);
+}
+
+#if DSX_AVX2
+__attribute__((target("avx2")))
+inline size_t markerAVX2(const char *p, size_t from, size_t n, bool col0) {
+	const __m256i nl = _mm256_set1_epi8('\n'), sp = _mm256_set1_epi8(col0 ? '\n' : ' ');
+	const __m256i B = _mm256_set1_epi8('B'), E = _mm256_set1_epi8('E'), N = _mm256_set1_epi8('N');
+	size_t i = from;
+	for (; i + 32 + 1 <= n; i += 32) {
+		__m256i prev = _mm256_loadu_si256((const __m256i *)(p + i - 1));
+		__m256i cur = _mm256_loadu_si256((const __m256i *)(p + i));
+		__m256i next = _mm256_loadu_si256((const __m256i *)(p + i + 1));
+		__m256i lead = _mm256_or_si256(_mm256_cmpeq_epi8(prev, nl), _mm256_cmpeq_epi8(prev, sp));
+		__m256i be = _mm256_and_si256(_mm256_cmpeq_epi8(cur, B), _mm256_cmpeq_epi8(next, E));
+		__m256i en = _mm256_and_si256(_mm256_cmpeq_epi8(cur, E), _mm256_cmpeq_epi8(next, N));
+		unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(lead, _mm256_or_si256(be, en)));
+		if (mask) return i + __builtin_ctz(mask);
+	}
+	return markerSSE2(p, i, n, col0);
+}
+#endif
+#endif
+
+// the kernels this CPU can run, best first
+inline std::vector<std::pair<const char *, marker_fn> > markerKernels() {
+	std::vector<std::pair<const char *, marker_fn> > k;
+#if DSX_SIMD
+	__builtin_cpu_init();
+#if DSX_AVX2
+	if (__builtin_cpu_supports("avx2")) k.push_back(std::make_pair("avx2", markerAVX2));
+#endif
+	if (__builtin_cpu_supports("sse2")) k.push_back(std::make_pair("sse2", markerSSE2));
+#endif
+	k.push_back(std::make_pair("scalar", markerScalar));
+	return k;
+}
+extern const std::pair<const char *, marker_fn> marker_kernel;	// the best of markerKernels()
+inline size_t findMarker(const char *p, size_t from, size_t n, bool col0) {
+	return marker_kernel.second(p, from, n, col0);
+}
+
+class DsxScanner {
+
+	private:
+	std::vector<string> mTags;	// open blocks, outer first
+	std::vector<size_t> mStarts;	// offset of their BEGIN lines
+	block_t mBlock;
+	size_t mBytes;
+	bool mStreamRecords;
+	bool mStopped;
+	std::function<bool(const char *, size_t)> mWant;	// top-level tags to look into
+	bool mSkip;		// in a top-level block not wanted
+	std::function<bool(const char *, size_t)> mStrip;	// sub-block tags to leave out
+	bool mCut;		// holes are cut by the caller
+	bool mHole;		// in a sub-block left out
+	bool mHoleDone;		// with mCut, closed but not cut yet
+	size_t mHoleStart;	// its BEGIN line
+	string mHoleEnd;	// its END line
+
+	// in a hole, from line start pos: past its END line, the rest of buf (but a
+	// partial last line) if it is not in it.
+	size_t skipHole(const char *buf, size_t n, size_t pos, size_t base, bool eof) {
+		size_t ind = mHoleEnd.find('E');
+		for (size_t i = pos + ind; i < n; i++) {
+			i = findMarker(buf, i > 0 ? i : 1, n, false);
+			if (i >= n) break;
+			size_t ls = i - ind;
+			if (ls < pos || (ls > 0 && buf[ls-1] != '\n') || n - ls < mHoleEnd.size() ||
+					0 != memcmp(buf + ls, mHoleEnd.data(), mHoleEnd.size())) continue;
+			size_t end = ls + mHoleEnd.size();
+			mHole = false;
+			if (mCut) mHoleDone = true;
+			else mBlock.holes.push_back({mHoleStart, base + end - mHoleStart});
+			mBytes += end - pos;
+			return end;
+		}
+		size_t end = n;
+		if (!eof) {
+			while (end > pos && buf[end-1] != '\n') end--;
+		}
+		mBytes += end - pos;
+		return end;
+	}
+
+	// in a block not wanted, from line start pos: where its END line starts, the rest
+	// of buf (but a partial last line) if it is not in it.
+	size_t skipBlock(const char *buf, size_t n, size_t pos, bool eof) {
+		const string &tag = mTags[0];
+		size_t need = 4 + tag.size() + strlen(DSXNEWLINE);
+		for (size_t i = pos; i < n; i++) {
+			if (i > 0) {
+				i = findMarker(buf, i, n, true);
+				if (i >= n) break;
+			}
+			if (n - i >= need && 0 == memcmp(buf + i, "END ", 4) &&
+					0 == tag.compare(0, string::npos, buf + i + 4, tag.size()) &&
+					0 == memcmp(buf + i + 4 + tag.size(), DSXNEWLINE, 2)) {
+				mSkip = false;
+				mBytes += i - pos;
+				return i;
+			}
+		}
+		size_t end = n;
+		if (!eof) {
+			while (end > pos && buf[end-1] != '\n') end--;
+		}
+		mBytes += end - pos;
+		return end;
+	}
+
+	public:
+	DsxScanner() : mBytes(0), mStreamRecords(false), mStopped(false), mSkip(false),
+		mCut(false), mHole(false), mHoleDone(false), mHoleStart(0) {}
+
+	// from a callback: scan no further
+	void stop() { mStopped = true; }
+	bool stopped() { return mStopped; }
+
+	size_t bytes() { return mBytes; }
+	int depth() { return mTags.size(); }
+	void streamRecords(bool b) { mStreamRecords = b; }
+	void want(std::function<bool(const char *, size_t)> f) { mWant = f; }
+	bool skipping() { return mSkip; }
+	void strip(std::function<bool(const char *, size_t)> f, bool cut = false) { mStrip = f; mCut = cut; }
+	// with cut, after feed(): true if the caller is to remove [start, where feed()
+	// stopped) from its buffer, a hole or the part of it read so far; then cut(),
+	// true if the hole is closed and feed() can go on after it.
+	bool cutFrom(size_t &start) {
+		start = mHoleStart;
+		return mHole || mHoleDone;
+	}
+	bool cut() {
+		bool done = mHoleDone;
+		mHoleDone = false;
+		return done;
+	}
+	// open blocks, 0 is the top-level one
+	const string & openTag(int i) { return mTags[i]; }
+	size_t openStart(int i) { return mStarts[i]; }
+
+	// feed one line, [p, p+len) including its line end, found at offset ofs.
+	// return true when a top-level block got closed by this line.
+	template<typename F>
+	bool line(const char *p, size_t len, size_t ofs, F onBlock) {
+		mBytes += len;
+		if (len < 2 + 4 || p[len-2] != '\r' || p[len-1] != '\n') return false;
+
+		size_t ind = 0;
+		while (ind < len && p[ind] == ' ') ind++;
+		if (ind % DSXINDENT != 0) return false;
+
+		const char *q = p + ind;
+		size_t qlen = len - ind - strlen(DSXNEWLINE);
+		size_t d = ind / DSXINDENT;
+		bool open;
+		if (qlen >= 6 && 0 == memcmp(q, "BEGIN ", 6)) {
+			if (d != mTags.size()) return false;
+			q += 6; qlen -= 6;
+			open = true;
+		} else if (qlen >= 4 && 0 == memcmp(q, "END ", 4)) {
+			// a column 0 END may close the top-level block with others still open
+			if (d + 1 != mTags.size() && !(d == 0 && mTags.size() > 1)) return false;
+			q += 4; qlen -= 4;
+			open = false;
+		} else {
+			return false;
+		}
+		for (size_t i = 0; i < qlen; i++)
+			if (q[i] < 'A' || q[i] > 'Z') return false;
+		// below the top level only DSX structure nests (DSRECORD, DSSUBRECORD, ...),
+		// "BEGIN TRANSACTION" in a routine source is content
+		if (d > 0 && (qlen < 2 || q[0] != 'D' || q[1] != 'S')) return false;
+
+		if (open) {
+			if (d > 0 && mStrip && mStrip(q, qlen)) {
+				mHole = true;
+				mHoleStart = ofs;
+				mHoleEnd = string(ind, ' ') + "END " + string(q, qlen) + DSXNEWLINE;
+				return false;
+			}
+			if (d == 0 && mWant && !mWant(q, qlen)) mSkip = true;
+			mTags.push_back(string(q, qlen));
+			mStarts.push_back(ofs);
+			return false;
+		}
+		if (d == 0 && mTags.size() > 1) {
+			// resync: blocks left open in it were content that looked like BEGIN lines
+			if (0 != mTags[0].compare(0, string::npos, q, qlen)) return false;
+			mTags.resize(1);
+			mStarts.resize(1);
+		}
+		if (0 != mTags.back().compare(0, string::npos, q, qlen)) return false;
+
+		span_t sp = {mStarts.back(), ofs + len - mStarts.back()};
+		mTags.pop_back();
+		mStarts.pop_back();
+
+		if (d == 1 && qlen == 8 && 0 == memcmp(q, "DSRECORD", 8)) {
+			mBlock.records.push_back(sp);
+			if (mStreamRecords) {
+				mBlock.type = mTags[0];
+				mBlock.body.ofs = mStarts[0];
+				mBlock.body.len = 0;
+				mBlock.closed = false;
+				onBlock(mBlock);
+				mBlock.records.clear();
+			}
+		} else if (d == 0) {
+			mBlock.type.assign(q, qlen);
+			mBlock.body = sp;
+			mBlock.closed = true;
+			onBlock(mBlock);
+			mBlock.records.clear();
+			mBlock.holes.clear();
+			return true;
+		}
+		return false;
+	}
+
+	// feed the lines of buf from line start pos on, buf[0] at input offset base.
+	// Only lines findMarker() points at go to line(), the others can't be BEGIN/END
+	// lines. Without eof, a last line without line end is left. Return where the
+	// lines not fed start.
+	template<typename F>
+	size_t feed(const char *buf, size_t n, size_t pos, size_t base, bool eof, F onBlock) {
+		size_t from = pos;
+		while (pos < n && !mStopped) {
+			if (mSkip) {
+				pos = from = skipBlock(buf, n, pos, eof);
+				if (mSkip) return pos;
+			}
+			if (mHole) {
+				pos = from = skipHole(buf, n, pos, base, eof);
+				if (mHole || mCut) return pos;
+			}
+			size_t i, ls;
+			if (pos == 0) {
+				i = ls = 0;	// no line end before it to find it by
+			} else {
+				i = findMarker(buf, from > pos ? from : pos, n, false);
+				if (i >= n) break;
+				for (ls = i; ls > pos && buf[ls-1] == ' '; ) ls--;
+				from = i + 1;
+				if (ls != pos && buf[ls-1] != '\n') continue;	// in a line
+			}
+			const char *nl = (const char *)memchr(buf + i, '\n', n - i);
+			if (nl == NULL && !eof) {
+				mBytes += ls - pos;
+				return ls;
+			}
+			size_t len = (nl ? (size_t)(nl - buf) + 1 : n) - ls;
+			mBytes += ls - pos;
+			line(buf + ls, len, base + ls, onBlock);
+			pos = from = ls + len;
+		}
+		if (mStopped || pos >= n) return pos;
+		// no BEGIN/END line in the rest
+		size_t end = n;
+		if (!eof) {
+			while (end > pos && buf[end-1] != '\n') end--;
+		}
+		mBytes += end - pos;
+		return end;
+	}
+
+	// scan a whole buffer
+	template<typename F>
+	void scan(const char *buf, size_t n, F onBlock) {
+		feed(buf, n, 0, 0, true, onBlock);
+	}
+}; // class DsxScanner
+
+/*
+ * XML tokenizer, SAX style, for XML exports (<DSExport>): one forward pass handing
+ * start and end tags to a callback, with their depth (1 for the root) and spans.
+ * Nothing is built, no DOM. Comments, CDATA, processing instructions and DOCTYPE are
+ * skipped whole, a '>' in a quoted attribute value does not end a tag. Text is not
+ * handed over, textStart() tells where the text before a tag starts.
+ */
+enum { XML_START, XML_END, XML_EMPTY };
+typedef struct {
+	int kind;		// XML_START, XML_END, XML_EMPTY (<a/>)
+	const char *name;
+	size_t nameLen;
+	const char *p;		// "<...>"
+	span_t span;		// of the tag, input offsets
+	int depth;		// of the element
+} xml_tag_t;
+
+class XmlScanner {
+	private:
+	int mDepth;
+	size_t mBytes;
+	size_t mTextStart;	// input offset after the last tag
+	bool mStopped;
+	bool mError;
+
+	static size_t findStr(const char *buf, size_t from, size_t n, const char *str) {
+		size_t len = strlen(str);
+		while (from + len <= n) {
+			const char *c = (const char *)memchr(buf + from, str[0], n - from - len + 1);
+			if (c == NULL) break;
+			if (0 == memcmp(c, str, len)) return c - buf + len;
+			from = c - buf + 1;
+		}
+		return string::npos;
+	}
+
+	public:
+	XmlScanner() : mDepth(0), mBytes(0), mTextStart(0), mStopped(false), mError(false) {}
+
+	void stop() { mStopped = true; }
+	bool stopped() { return mStopped; }
+	// tags not nested right, or markup not closed at the end
+	bool error() { return mError; }
+	int depth() { return mDepth; }
+	size_t bytes() { return mBytes; }
+	size_t textStart() { return mTextStart; }
+
+	// feed buf from pos on, buf[0] at input offset base. Without eof, markup not
+	// complete in buf is left for more. Return where the bytes not fed start.
+	template<typename F>
+	size_t feed(const char *buf, size_t n, size_t pos, size_t base, bool eof, F onTag) {
+		while (pos < n && !mStopped) {
+			const char *lt = (const char *)memchr(buf + pos, '<', n - pos);
+			size_t i = lt ? (size_t)(lt - buf) : n;
+			mBytes += i - pos;
+			pos = i;
+			if (i == n) break;
+			if (n - i < 9 && !eof) break;	// "<![CDATA[" may be cut
+
+			size_t end = string::npos;
+			if (0 == strncmp(buf + i, "<!--", std::min<size_t>(4, n - i))) end = findStr(buf, i + 4, n, "-->");
+			else if (0 == strncmp(buf + i, "<![CDATA[", std::min<size_t>(9, n - i))) end = findStr(buf, i + 9, n, "]]>");
+			else if (0 == strncmp(buf + i, "<?", std::min<size_t>(2, n - i))) end = findStr(buf, i + 2, n, "?>");
+			else {
+				// a tag, or <!DOCTYPE ...[...]>
+				char quote = 0;
+				int bracket = 0;
+				for (size_t k = i + 1; k < n; k++) {
+					char c = buf[k];
+					if (quote) { if (c == quote) quote = 0; }
+					else if (c == '"' || c == '\'') quote = c;
+					else if (c == '[') bracket++;
+					else if (c == ']') bracket--;
+					else if (c == '>' && bracket <= 0) { end = k + 1; break; }
+				}
+				if (end != string::npos && buf[i+1] != '!') {
+					xml_tag_t t;
+					t.p = buf + i;
+					t.span.ofs = base + i;
+					t.span.len = end - i;
+					bool close = (buf[i+1] == '/');
+					t.name = buf + i + (close ? 2 : 1);
+					size_t k = t.name - buf;
+					while (k < end - 1 && buf[k] != ' ' && buf[k] != '\t' && buf[k] != '\r' && buf[k] != '\n' && buf[k] != '/' && buf[k] != '>') k++;
+					t.nameLen = buf + k - t.name;
+					if (close) {
+						t.kind = XML_END;
+						t.depth = mDepth;
+						if (mDepth == 0) mError = true;
+						else mDepth--;
+					} else {
+						t.kind = (buf[end-2] == '/') ? XML_EMPTY : XML_START;
+						t.depth = mDepth + 1;
+						if (t.kind == XML_START) mDepth++;
+					}
+					onTag(t);
+				}
+			}
+			if (end == string::npos) {
+				if (!eof) break;
+				mError = true;	// not closed
+				end = n;
+			}
+			mBytes += end - pos;
+			pos = end;
+			mTextStart = base + end;
+		}
+		return pos;
+	}
+}; // class XmlScanner
+
+// text or attribute value with the entities replaced
+inline std::string xmlUnescape(const char *p, size_t n) {
+	std::string out;
+	out.reserve(n);
+	for (size_t i = 0; i < n; i++) {
+		const char *semi;
+		if (p[i] != '&' || (semi = (const char *)memchr(p + i, ';', std::min<size_t>(n - i, 12))) == NULL) {
+			out += p[i];
+			continue;
+		}
+		std::string ent(p + i + 1, semi);
+		unsigned long code = 0;
+		if (ent == "amp") out += '&';
+		else if (ent == "lt") out += '<';
+		else if (ent == "gt") out += '>';
+		else if (ent == "quot") out += '"';
+		else if (ent == "apos") out += '\'';
+		else if (ent.size() > 1 && ent[0] == '#') {
+			code = (ent[1] == 'x') ? strtoul(ent.c_str() + 2, NULL, 16) : strtoul(ent.c_str() + 1, NULL, 10);
+			if (code < 0x80) out += (char)code;
+			else if (code < 0x800) { out += (char)(0xc0 | code >> 6); out += (char)(0x80 | (code & 0x3f)); }
+			else { out += (char)(0xe0 | code >> 12); out += (char)(0x80 | (code >> 6 & 0x3f)); out += (char)(0x80 | (code & 0x3f)); }
+		} else {
+			out.append(p + i, semi - p - i + 1);	// not known, as is
+		}
+		i = semi - p;
+	}
+	return out;
+}
+
+// value of attribute name of a start tag, empty if it has none
+inline std::string xmlAttr(const xml_tag_t &t, const char *name) {
+	size_t len = strlen(name);
+	const char *p = t.p + 1 + t.nameLen, *e = t.p + t.span.len;
+	while (p < e) {
+		while (p < e && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+		const char *a = p;
+		while (p < e && *p != '=' && *p != ' ' && *p != '>' && *p != '/') p++;
+		const char *ae = p;
+		while (p < e && *p == ' ') p++;
+		if (p >= e || *p != '=') { p++; continue; }
+		p++;
+		while (p < e && *p == ' ') p++;
+		if (p >= e || (*p != '"' && *p != '\'')) continue;
+		char q = *p++;
+		const char *v = p;
+		while (p < e && *p != q) p++;
+		if ((size_t)(ae - a) == len && 0 == memcmp(a, name, len)) return xmlUnescape(v, p - v);
+		p++;
+	}
+	return "";
+}
+
+// XML export elements under the root: a component each, or for a group a Record each
+typedef struct {
+	const char *elem;
+	const char *type;	// in comp_types
+	bool group;
+} xml_type_t;
+const xml_type_t xml_types[] = {
+	{"Job", "DSJOB", false}, {"SharedContainer", "DSSHAREDCONTAINER", false},
+	{"Routine", "DSROUTINES", false}, {"Routines", "DSROUTINES", true},
+	{"ParameterSet", "DSPARAMETERSETS", false}, {"ParameterSets", "DSPARAMETERSETS", true},
+	{"TableDefinition", "DSTABLEDEFS", false}, {"TableDefinitions", "DSTABLEDEFS", true},
+	{"DataType", "DSDATATYPES", false}, {"DataTypes", "DSDATATYPES", true},
+	{"Transform", "DSTRANSFORMES", false}, {"Transforms", "DSTRANSFORMES", true},
+	{"StageType", "DSSTAGETYPES", false}, {"StageTypes", "DSSTAGETYPES", true},
+};
+
+inline const xml_type_t * findXmlType(const char *elem, size_t n) {
+	for (const xml_type_t &x : xml_types)
+		if (strlen(x.elem) == n && 0 == memcmp(x.elem, elem, n)) return &x;
+	return NULL;
+}
+
+// first non blank byte of file is '<' (after a BOM): an XML export
+inline bool isXmlFile(const std::string &file) {
+	char buf[256];
+	FILE *fp = fopen(file.c_str(), "rb");
+	if (fp == NULL) return false;
+	size_t n = fread(buf, 1, sizeof(buf), fp);
+	fclose(fp);
+	size_t i = (n >= 3 && 0 == memcmp(buf, "\xef\xbb\xbf", 3)) ? 3 : 0;
+	while (i < n && (buf[i] == ' ' || buf[i] == '\t' || buf[i] == '\r' || buf[i] == '\n')) i++;
+	return i < n && buf[i] == '<';
+}
+
+
+// length of "BEGIN "/"END " when [p, p+len) is a column 0 "BEGIN X\r\n"/"END X\r\n"
+// line with X in [A-Z]*, 0 otherwise
+inline size_t lineTag(const char *p, size_t len) {
+	size_t t;
+	if (len >= 6 + 2 && 0 == memcmp(p, "BEGIN ", 6)) t = 6;
+	else if (len >= 4 + 2 && 0 == memcmp(p, "END ", 4)) t = 4;
+	else return 0;
+	if (p[len-2] != '\r' || p[len-1] != '\n') return 0;
+	for (size_t i = t; i < len - 2; i++)
+		if (p[i] < 'A' || p[i] > 'Z') return 0;
+	return t;
+}
+
+// call fn(0) .. fn(n-1) from up to nThreads threads
+template<typename F>
+void parallelFor(int nThreads, size_t n, F fn) {
+	std::atomic<size_t> next(0);
+	auto work = [&]() {
+		for (size_t i; (i = next++) < n; ) fn(i);
+	};
+	std::vector<std::thread> threads;
+	for (int t = 1; t < nThreads && (size_t)t < n; t++) threads.push_back(std::thread(work));
+	work();
+	for (std::thread &t : threads) t.join();
+}
+
+// s as a JSON string
+inline std::string jsonStr(const std::string &s) {
+	std::string out = "\"";
+	for (unsigned char ch : s) {
+		if (ch == '"' || ch == '\\') out += '\\';
+		if (ch < 0x20) out += string_format("\\u%04x", ch);
+		else out += ch;
+	}
+	return out + "\"";
+}
+
+/*
+ * --stats: where the time and bytes of a run went. Read and parse are timed around
+ * the calls, CPU is that of the whole process meanwhile (parser threads included).
+ * Pack and write are summed over the writer threads, CPU is that of each thread.
+ */
+#define STATS_LARGEST 10
+class Stats {
+public:
+	enum { READ, PARSE, PACK, WRITE, NPHASE };
+	typedef struct { std::chrono::steady_clock::time_point wall; double cpu; } mark_t;
+
+	bool on;
+
+	Stats(): on(false), mT0(std::chrono::steady_clock::now()) {
+		for (int i = 0; i < NPHASE; i++) { mWall[i] = 0; mCpu[i] = 0; }
+		mBytesIn = mBytesOut = 0;
+		mDirs = mErrors = mLinked = 0;
+	}
+
+	static double cpuProcess() {
+#ifndef _WIN32
+		struct rusage ru;
+		getrusage(RUSAGE_SELF, &ru);
+		return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+#else
+		return (double)clock() / CLOCKS_PER_SEC;
+#endif
+	}
+	static double cpuThread() {
+#ifndef _WIN32
+		struct timespec ts;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+		return ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+		return 0;
+#endif
+	}
+	// start of a phase, thread: run by a writer thread
+	mark_t mark(bool thread = false) {
+		mark_t m = {std::chrono::steady_clock::now(), on ? (thread ? cpuThread() : cpuProcess()) : 0};
+		return m;
+	}
+	void add(int phase, const mark_t &m, bool thread = false) {
+		if (!on) return;
+		mWall[phase] += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m.wall).count();
+		mCpu[phase] += (long long)(((thread ? cpuThread() : cpuProcess()) - m.cpu) * 1e6);
+	}
+	void bytesIn(size_t n) { mBytesIn += n; }
+	void dirCreated() { mDirs++; }
+	void writeError() { mErrors++; }
+	int writeErrors() { return mErrors; }
+	void linked() { mLinked++; }
+	// a component written (or checked with -i), of bytes packed
+	void component(const std::string &type, const std::string &path, const std::string &name, size_t bytes) {
+		if (!on) return;
+		mBytesOut += bytes;
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTypes[type]++;
+		if (mLargest.size() == STATS_LARGEST && bytes <= mLargest.back().bytes) return;
+		big_t b = {type, path, name, bytes};
+		auto it = std::upper_bound(mLargest.begin(), mLargest.end(), b, [](const big_t &x, const big_t &y) { return x.bytes > y.bytes; });
+		mLargest.insert(it, b);
+		if (mLargest.size() > STATS_LARGEST) mLargest.pop_back();
+	}
+	// peak resident set size, in KB
+	static long peakRSS() {
+#ifndef _WIN32
+		struct rusage ru;
+		getrusage(RUSAGE_SELF, &ru);
+		return ru.ru_maxrss;
+#else
+		return 0;
+#endif
+	}
+
+	// format "text" or "json"
+	void report(const std::string &format, std::ostream &out) {
+		static const char *names[NPHASE] = {"read", "parse", "pack", "write"};
+		double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - mT0).count();
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (format == "json") {
+			out << "{\"wall\":" << string_format("%.6f", wall) << ",\"cpu\":" << string_format("%.6f", cpuProcess()) << ",\"phases\":{";
+			for (int i = 0; i < NPHASE; i++)
+				out << (i ? "," : "") << string_format("\"%s\":{\"wall\":%.6f,\"cpu\":%.6f}", names[i], mWall[i] / 1e6, mCpu[i] / 1e6);
+			out << "},\"bytes_in\":" << mBytesIn << ",\"bytes_out\":" << mBytesOut << ",\"components\":{";
+			bool first = true;
+			for (const auto &t : mTypes) {
+				out << (first ? "" : ",") << jsonStr(t.first) << ":" << t.second;
+				first = false;
+			}
+			out << "},\"largest\":[";
+			for (size_t i = 0; i < mLargest.size(); i++)
+				out << (i ? "," : "") << "{\"type\":" << jsonStr(mLargest[i].type) << ",\"path\":" << jsonStr(mLargest[i].path)
+					<< ",\"name\":" << jsonStr(mLargest[i].name) << ",\"bytes\":" << mLargest[i].bytes << "}";
+			out << "],\"dirs_created\":" << mDirs << ",\"linked\":" << mLinked << ",\"write_errors\":" << mErrors
+				<< ",\"peak_rss_kb\":" << peakRSS() << "}" << std::endl;
+			return;
+		}
+		out << string_format("Stats: %.3fs wall, %.3fs cpu, peak RSS %ld KB", wall, cpuProcess(), peakRSS()) << std::endl;
+		for (int i = 0; i < NPHASE; i++)
+			out << string_format("  %-6s %10.3fs wall %10.3fs cpu", names[i], mWall[i] / 1e6, mCpu[i] / 1e6) << std::endl;
+		out << string_format("  bytes in %llu, out %llu", (unsigned long long)mBytesIn, (unsigned long long)mBytesOut) << std::endl;
+		for (const auto &t : mTypes) out << string_format("  %-18s %8d", t.first.c_str(), t.second) << std::endl;
+		out << "  dirs created " << mDirs << ", linked " << mLinked << ", write errors " << mErrors << std::endl;
+		for (const big_t &b : mLargest)
+			out << string_format("  %12llu  %-18s %s/%s", (unsigned long long)b.bytes, b.type.c_str(), b.path.c_str(), b.name.c_str()) << std::endl;
+	}
+private:
+	typedef struct { std::string type, path, name; size_t bytes; } big_t;
+	std::chrono::steady_clock::time_point mT0;
+	std::atomic<long long> mWall[NPHASE], mCpu[NPHASE];	// microseconds
+	std::atomic<unsigned long long> mBytesIn, mBytesOut;
+	std::atomic<int> mDirs, mErrors, mLinked;
+	std::mutex mMutex;
+	std::map<std::string, int> mTypes;
+	std::vector<big_t> mLargest;	// by size, descending
+};
+
+/*
+ * Strings many components share (types, categories), kept once: a component holds a
+ * pointer, not a copy. A std::set does not move its elements, the pointers stay
+ * valid. Each Collection has one, freed with it and its components.
+ */
+class StringPool {
+	std::set<std::string> mStrings;
+	std::mutex mMutex;
+	public:
+	const std::string * intern(const std::string &s) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return &*mStrings.insert(s).first;
+	}
+	size_t size() {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mStrings.size();
+	}
+};
+extern const std::string *EMPTY_STR;	// type and category of a component not set
+
+// a name a component refers to, of type ct. sure: it has to be in the export (a
+// call, a parameter), otherwise a candidate that may name nothing.
+typedef struct {
+	const comp_t *ct;
+	std::string name;
+	bool sure;
+} ref_t;
+
+inline bool identChar(char c) {
+	return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+class Component {
+
+	private:
+	const char *mSrc;	// start of the collection buffer (mapping), not owned
+	span_t mSpan;		// body of this component in mSrc
+	std::vector<span_t> mHoles;	// in mSrc, in mSpan, left out of the body (--strip-binaries)
+	const std::string *mType;	// in comp_types or a StringPool
+	string mName;
+	const std::string *mCate;	// in a StringPool
+
+	// attribute index, '<indent>Name "value"' lines of level 1 and 2, offsets relative
+	// to the body. Built lazily: lines are indexed only as far as lookups needed.
+	typedef struct {
+		int level;
+		span_t name;
+		span_t value;
+	} attr_t;
+	std::vector<attr_t> mAttrs;
+	size_t mAttrOfs;	// body indexed up to here
+	uint64_t mHash;		// of the body, 0 until getHash()
+
+	//int ofs_curr;
+
+	// index lines from mAttrOfs on, until one is (level, name), or to the end
+	const attr_t * indexAttrs(int level, const std::string &name) {
+		const char *p = bodyData();
+		size_t n = bodySize();
+		while (mAttrOfs < n) {
+			const char *line = p + mAttrOfs;
+			const char *nl = (const char *)memchr(line, '\n', n - mAttrOfs);
+			size_t len = (nl ? (size_t)(nl - line) + 1 : n - mAttrOfs);
+			size_t ofs = mAttrOfs;
+			mAttrOfs += len;
+
+			// '   Name "value"\r\n' or '      Name "value"\r\n', value without quotes
+			size_t ind = 0;
+			while (ind < len && line[ind] == ' ') ind++;
+			if ((ind != DSXINDENT && ind != 2 * DSXINDENT) || len < ind + 6 ||
+				line[len-1] != '\n' || line[len-2] != '\r' || line[len-3] != '"') continue;
+			const char *sp = (const char *)memchr(line + ind, ' ', len - ind);
+			if (sp == NULL || sp[1] != '"') continue;
+			const char *v = sp + 2, *ve = line + len - 3;
+			if (v >= ve || memchr(v, '"', ve - v) != NULL) continue;
+
+			attr_t a = {(int)(ind / DSXINDENT),
+				{ofs + ind, (size_t)(sp - line) - ind},
+				{(size_t)(v - p), (size_t)(ve - v)}};
+			mAttrs.push_back(a);
+			if (a.level == level && 0 == name.compare(0, string::npos, p + a.name.ofs, a.name.len))
+				return &mAttrs.back();
+		}
+		return NULL;
+	}
+
+	public:
+	Component() : mSrc(NULL), mType(EMPTY_STR), mCate(EMPTY_STR), mAttrOfs(0), mHash(0) { mSpan.ofs = mSpan.len = 0; }
+	// type and category interned in pool, which is to outlive the component
+	Component(const char *src, span_t span, std::string type, std::string name, std::string cate, StringPool &pool) : mAttrOfs(0), mHash(0)
+       	{
+		setBody(src, span);
+		setType(type, pool);
+		setName(name);
+		setCate(cate, pool);
+	}
+	static inline std::string getDirSeptChar() {
+#ifdef _WIN32
+		//std::cout << "It is WIN32 FS" << std::endl;
+		return "\\";
+#else
+		//std::cout << "It is Unix/Linux FS " << std::endl;
+		return "/";
+#endif
+	}
+	void clear() {
+		mSrc = NULL;
+		mSpan.ofs = mSpan.len = 0;
+		mAttrs.clear();
+		mAttrOfs = 0;
+		mHash = 0;
+		mType = EMPTY_STR;
+		mName.clear();
+		mCate = EMPTY_STR;
+	}
+	// free the attribute index, it is rebuilt if getAttr() is called again
+	void dropAttrs() {
+		std::vector<attr_t>().swap(mAttrs);
+		mAttrOfs = 0;
+	}
+
+	// Category "\\Jobs\\Load" (escaped backslashes in dsx) to Jobs/Load
+	std::string getPath() {
+		const std::string &cate = *mCate;
+		std::string path;
+		path.reserve(cate.size());
+		for (size_t i = 0; i < cate.size(); i++) {
+			if (cate[i] == '\\' && i + 1 < cate.size() && cate[i+1] == '\\') {
+				path += Component::getDirSeptChar();
+				i++;
+			} else {
+				path += cate[i];
+			}
+		}
+		return path;
+
+	}
+
+	void setBody(const char *src, span_t span) { mSrc = src; mSpan = span; mHoles.clear(); mAttrs.clear(); mAttrOfs = 0; mHash = 0; }
+	// take those of holes (in order) that are in the body
+	void setHoles(const std::vector<span_t> &holes) {
+		for (const span_t &h : holes)
+			if (h.ofs >= mSpan.ofs && h.ofs + h.len <= mSpan.ofs + mSpan.len) mHoles.push_back(h);
+		mHash = 0;
+	}
+	// the body as written: the span without its holes
+	void bodyPieces(std::vector<piece_t> &out) {
+		size_t at = mSpan.ofs, end = mSpan.ofs + mSpan.len;
+		for (const span_t &h : mHoles) {
+			if (h.ofs > at) out.push_back({mSrc + at, h.ofs - at, -1});
+			at = h.ofs + h.len;
+		}
+		if (end > at) out.push_back({mSrc + at, end - at, -1});
+	}
+	size_t contentSize() {
+		size_t n = mSpan.len;
+		for (const span_t &h : mHoles) n -= h.len;
+		return n;
+	}
+	void setHash(uint64_t hash) { mHash = hash; }
+	void setType(const std::string &type, StringPool &pool) {
+		const comp_t *ct = findCompType(type);
+		mType = ct ? &ct->type : pool.intern(type);
+	}
+	void setName(std::string name) { mName = name; }
+	void setCate(const std::string &cate, StringPool &pool) { mCate = pool.intern(cate); }
+	std::string getBody() {
+		if (mHoles.empty()) return std::string(bodyData(), bodySize());
+		std::vector<piece_t> pieces;
+		bodyPieces(pieces);
+		std::string body;
+		body.reserve(contentSize());
+		for (const piece_t &p : pieces) body.append(p.p, p.len);
+		return body;
+	}
+	const char * bodyData() {return mSrc + mSpan.ofs;}
+	size_t bodySize() {return mSpan.len;}
+	span_t getSpan() {return mSpan;}
+	const std::string & getType() {return *mType;}
+	const std::string & getName() {return mName;}
+	const std::string & getCate() {return *mCate;}
+	uint64_t getHash() {
+		if (mHash == 0) {
+			Hash64 h;
+			std::vector<piece_t> pieces;
+			bodyPieces(pieces);
+			for (const piece_t &p : pieces) h.add(p.p, p.len);
+			mHash = h.value();
+		}
+		return mHash;
+	}
+
+	int getLevelByType(std::string type) {
+		const comp_t *ct = findCompType(type);
+		if (ct == NULL) {
+			//std::cout << "getLevelByType(): hit=0, return -1" <<std::endl;
+			return -1;
+		}
+
+		return ct->entity_level;
+	}
+
+	// What the body refers to: DSU.<name> routine calls, parameter sets of parameters
+	// (ParamType "13") and of #<set>.<param># uses, and as shared container candidates
+	// the values of the records of container stages. Types not in types are left out.
+	void refs(std::vector<ref_t> &out, const CompTypeTable &types) {
+		const comp_t *rt = types.find("DSROUTINES"), *ps = types.find("DSPARAMETERSETS");
+		const comp_t *sc = types.find("DSSHAREDCONTAINER");
+		const char *p = bodyData(), *end = p + bodySize();
+
+		// DSU.X anywhere, code included
+		for (const char *s = p; rt && (s = (const char *)memchr(s, 'D', end - s)) != NULL; s++) {
+			if (end - s < 5 || memcmp(s, "DSU.", 4) != 0 || (s > p && identChar(s[-1]))) continue;
+			const char *e = s + 4;
+			while (e < end && identChar(*e)) e++;
+			if (e > s + 4) out.push_back({rt, std::string(s + 4, e), true});
+			s = e - 1;
+		}
+		// #X.Y#
+		for (const char *s = p; ps && (s = (const char *)memchr(s, '#', end - s)) != NULL; s++) {
+			const char *e = s + 1;
+			while (e < end && identChar(*e)) e++;
+			if (e == s + 1 || e >= end || *e != '.') continue;
+			const char *f = e + 1;
+			while (f < end && identChar(*f)) f++;
+			if (f == e + 1 || f >= end || *f != '#') continue;
+			out.push_back({ps, std::string(s + 1, e), false});
+			s = f - 1;
+		}
+		// attribute lines: '<indent>Name "value"'
+		std::string name;		// last Name value
+		std::vector<std::string> vals;	// of the record open at recInd
+		size_t recInd = string::npos;
+		bool container = false;
+		for (const char *line = p; line < end; ) {
+			const char *nl = (const char *)memchr(line, '\n', end - line);
+			const char *le = nl ? nl + 1 : end;
+			size_t len = le - line, ind = 0;
+			while (ind < len && line[ind] == ' ') ind++;
+			const char *q = line + ind, *qe = le;
+			while (qe > q && (qe[-1] == '\n' || qe[-1] == '\r')) qe--;
+			line = le;
+			if (qe - q == 14 && 0 == memcmp(q, "BEGIN DSRECORD", 14)) {
+				recInd = ind;
+				vals.clear();
+				container = false;
+				continue;
+			}
+			if (qe - q == 12 && 0 == memcmp(q, "END DSRECORD", 12) && ind == recInd) {
+				if (container && sc)
+					for (const std::string &v : vals) out.push_back({sc, v, false});
+				recInd = string::npos;
+				continue;
+			}
+			const char *sp = (const char *)memchr(q, ' ', qe - q);
+			if (sp == NULL || qe - sp < 3 || sp[1] != '"' || qe[-1] != '"') continue;
+			std::string attr(q, sp), val(sp + 2, qe - 1);
+			if (attr == "Name") name = val;
+			else if (attr == "ParamType" && val == "13" && ps && !name.empty()) out.push_back({ps, name, true});
+			else if (attr == "OLEType" && val.find("ContainerStage") != string::npos) container = true;
+			if (recInd != string::npos && ind == recInd + DSXINDENT) vals.push_back(val);
+		}
+	}
+
+	// value of the first '<indent>str "value"' line, indent 3 for level 1, 6 for level 2.
+	// Empty if there is none. Not to be called from two threads for one Component.
+	std::string getAttr(int level, std::string str){
+		for (const attr_t &a : mAttrs) {
+			if (a.level == level && 0 == str.compare(0, string::npos, bodyData() + a.name.ofs, a.name.len))
+				return std::string(bodyData() + a.value.ofs, a.value.len);
+		}
+		const attr_t *a = indexAttrs(level, str);
+		if (a) return std::string(bodyData() + a->value.ofs, a->value.len);
+		return "";
+	}
+		
+	std::string pack2() {
+		//std::cout <<" pack2" <<std::endl;
+		int L = getLevelByType(*mType);
+		//std::cout << "pack2(): L= " <<L<<std::endl;
+		if (L < 1) {
+			//std::cout << "hit L <1 "<< std::endl;
+			return "";
+		}
+		return getBody();
+	}
+	// pack1() as pieces: the body and, for level 2, its wrapper lines from static
+	// storage. Nothing is copied, the pieces point into the body and comp_types.
+	void pack1(std::vector<piece_t> &out) {
+		const comp_t *ct = findCompType(*mType);
+		if (ct == NULL) return;
+		if (ct->entity_level == 1) {
+			bodyPieces(out);
+		} else if (ct->entity_level == 2) {
+			piece_t begin = {"BEGIN ", 6, -1}, end = {"END ", 4, -1};
+			piece_t type = {ct->type.data(), ct->type.size(), -1}, crlf = {DSXNEWLINE, 2, -1};
+			out.push_back(begin); out.push_back(type); out.push_back(crlf);
+			bodyPieces(out);
+			out.push_back(end); out.push_back(type); out.push_back(crlf);
+		}
+	}
+	std::string pack1() {
+		//std::cout <<" pack1" <<std::endl;
+		int L = getLevelByType(*mType);
+		string sType = getType();
+		//std::cout << "pack1(): type= " << sType << std::endl;
+		if (L == 1) return getBody();
+		if (L == 2) {
+			return ("BEGIN "+ sType+ DSXNEWLINE + pack2() + "END "+ sType + DSXNEWLINE);
+		}
+
+
+		return "";
+	}
+
+	/*
+	bool parseObj(string body, int &ofs); // parse and populate fields.
+
+	int search(string body, int &ofs);	// find first qualify Component ofs
+	*/
+}; //class  Component
+
+
+// shell style pattern: * any string, ? any character
+inline bool globMatch(const char *pat, const char *str) {
+	const char *star = NULL, *retry = NULL;
+	while (*str) {
+		if (*pat == '*') {
+			star = ++pat;
+			retry = str;
+		} else if (*pat == '?' || *pat == *str) {
+			pat++;
+			str++;
+		} else if (star) {
+			pat = star;
+			str = ++retry;
+		} else {
+			return false;
+		}
+	}
+	while (*pat == '*') pat++;
+	return *pat == 0;
+}
+
+/*
+ * Components to extract: --only (name), --type (type or short type, e.g. DSJOB or
+ * JOB) and --category (Category as in the dsx, or as path when it has a '/')
+ * patterns. A component is taken if it matches one pattern of each given kind.
+ * With --only names only, no wildcards, the parse can stop when all are found.
+ */
+class Selection {
+	private:
+	std::vector<std::string> mNames, mTypes, mCates;
+	std::set<std::string> mPending;		// exact names, not found yet
+	bool mExact;
+	std::mutex mMutex;
+
+	static bool any(const std::vector<std::string> &pats, const std::string &str) {
+		for (const std::string &p : pats)
+			if (globMatch(p.c_str(), str.c_str())) return true;
+		return false;
+	}
+
+	public:
+	Selection(const std::vector<std::string> &names, const std::vector<std::string> &types, const std::vector<std::string> &cates)
+		: mNames(names), mTypes(types), mCates(cates), mExact(!names.empty()) {
+		for (const std::string &n : mNames) {
+			if (n.find_first_of("*?") != string::npos) mExact = false;
+			mPending.insert(n);
+		}
+	}
+	bool empty() { return mNames.empty() && mTypes.empty() && mCates.empty(); }
+	bool canStop() { return mExact; }
+
+	bool typeOk(const comp_t &ct) {
+		return mTypes.empty() || ct.type == "HEADER" || any(mTypes, ct.type) || any(mTypes, ct.type_short);
+	}
+	// type, name and category
+	bool ok(Component *c) {
+		const comp_t *ct = findCompType(c->getType());
+		if (ct == NULL || !typeOk(*ct)) return false;
+		if (!mNames.empty() && !any(mNames, c->getName())) return false;
+		if (!mCates.empty()) {
+			bool hit = false;
+			for (const std::string &p : mCates)
+				if (globMatch(p.c_str(), (p.find('/') != string::npos ? c->getPath() : c->getCate()).c_str())) hit = true;
+			if (!hit) return false;
+		}
+		return true;
+	}
+	// exact names not found (yet)
+	std::vector<std::string> pending() {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return std::vector<std::string>(mPending.begin(), mPending.end());
+	}
+	// c is taken, true if it was the last exact name pending
+	bool found(Component *c) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		mPending.erase(c->getName());
+		return mExact && mPending.empty();
+	}
+}; // class Selection
+
+/*
+ * Output files are written to a temporary name next to them and renamed into place
+ * when complete, so a crash or a full disk leaves the old file or none, never a
+ * truncated one. Nothing is flushed per file: syncOutput() does it once at the end.
+ */
+// path.<pid>.<n>.tmp, unique among the writers of this run and of other runs
+inline std::string tmpPath(const std::string &path) {
+	static std::atomic<unsigned> seq(0);
+#ifdef _WIN32
+	unsigned pid = (unsigned)_getpid();
+#else
+	unsigned pid = (unsigned)getpid();
+#endif
+	return path + string_format(".%u.%u.tmp", pid, (unsigned)seq++);
+}
+// tmp renamed to path if ok, else removed. True if path is in place
+inline bool replaceFile(const std::string &tmp, const std::string &path, bool ok) {
+#ifdef _WIN32
+	if (ok) std::remove(path.c_str());	// rename() does not replace on Windows
+#endif
+	if (ok && std::rename(tmp.c_str(), path.c_str()) == 0) return true;
+	std::remove(tmp.c_str());
+	return false;
+}
+// the files written under path (dir or file) to disk: syncfs() of its file system
+// on Linux, sync() elsewhere. False on a write back error
+inline bool syncOutput(const std::string &path) {
+#ifndef _WIN32
+#if defined(__linux__) && defined(SYS_syncfs)
+	// through syscall(), as copy_file_range (see Compatibility)
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd >= 0) {
+		bool ok = syscall(SYS_syncfs, fd) == 0;
+		close(fd);
+		return ok;
+	}
+#endif
+	sync();
+#endif
+	return true;
+}
+
+/*
+ * Writes one .dsx from a header and components, the inverse of the split. Level 2
+ * components of one type are put in one "BEGIN <type>" ... "END <type>" wrapper,
+ * components are to be added grouped by type. Output goes through a large stdio
+ * buffer, to a file or stdout ("-").
+ */
+class Composer {
+	private:
+	FILE *mOut;
+	std::string mPath, mTmp;	// file, written as mTmp until finish()
+	std::vector<char> mBuf;
+	const comp_t *mOpen;	// level 2 wrapper open
+	bool mOk;
+	int mCount;
+
+	void put(const char *p, size_t n) {
+		if (n > 0 && fwrite(p, 1, n, mOut) != n) mOk = false;
+	}
+	void put(const std::string &str) { put(str.data(), str.size()); }
+	void close() {
+		if (mOpen) put("END " + mOpen->type + DSXNEWLINE);
+		mOpen = NULL;
+	}
+
+	public:
+	Composer() : mOut(NULL), mBuf(1 << 20), mOpen(NULL), mOk(true), mCount(0) {}
+	~Composer() { finish(); }
+
+	bool open(const std::string &path) {
+		if (path == "-") {
+#ifdef _WIN32
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+			mOut = stdout;
+		} else {
+			mPath = path;
+			mTmp = tmpPath(path);
+			mOut = fopen(mTmp.c_str(), "wb");
+		}
+		if (mOut) setvbuf(mOut, mBuf.data(), _IOFBF, mBuf.size());
+		return mOut != NULL;
+	}
+	void header(const std::string &header) { put(header); }
+	// a component, body given separately if c is not to be read
+	void add(Component *c, const char *body = NULL, size_t len = 0) {
+		const comp_t *ct = findCompType(c->getType());
+		if (ct == NULL) return;
+		if (mOpen != ct) close();
+		if (ct->entity_level == 2 && mOpen == NULL) {
+			put("BEGIN " + ct->type + DSXNEWLINE);
+			mOpen = ct;
+		}
+		if (body) {
+			put(body, len);
+		} else {
+			std::vector<piece_t> pieces;
+			c->bodyPieces(pieces);
+			for (const piece_t &p : pieces) put(p.p, p.len);
+		}
+		mCount++;
+	}
+	int count() { return mCount; }
+	// true if all is written
+	bool finish() {
+		if (mOut == NULL) return mOk;
+		close();
+		if (fflush(mOut) != 0) mOk = false;
+		if (mOut != stdout && fclose(mOut) != 0) mOk = false;
+		if (mOut != stdout && !replaceFile(mTmp, mPath, mOk)) mOk = false;
+		mOut = NULL;
+		return mOk;
+	}
+}; // class Composer
+
+/*
+ * --tar: all files into one POSIX tar archive (ustar, a PAX header for longer paths),
+ * written front to back through a large buffer, gzip compressed with zlib if asked.
+ * Paths are relative, '/' separated. Not for concurrent writers; add() is locked.
+ */
+#define TAR_BLOCK 512
+class TarSink {
+	private:
+	FILE *mOut;
+	std::string mPath, mTmp;	// archive, written as mTmp until finish()
+#if ZLIB
+	gzFile mGz;
+#endif
+	std::vector<char> mBuf;
+	std::mutex mMutex;
+	time_t mMtime;
+	bool mOk;
+	int mCount;
+
+	void put(const char *p, size_t n) {
+		if (n == 0 || !mOk) return;
+#if ZLIB
+		if (mGz) {
+			if (gzwrite(mGz, p, (unsigned)n) != (int)n) mOk = false;
+			return;
+		}
+#endif
+		if (fwrite(p, 1, n, mOut) != n) mOk = false;
+	}
+	void pad(size_t n) {
+		static const char zeros[TAR_BLOCK] = {0};
+		if (n % TAR_BLOCK) put(zeros, TAR_BLOCK - n % TAR_BLOCK);
+	}
+	static void octal(char *field, size_t width, unsigned long long v) {
+		snprintf(field, width, "%0*llo", (int)width - 1, v);
+	}
+	// ustar header block of an entry of size bytes, name/prefix already split
+	void header(const std::string &name, const std::string &prefix, unsigned long long size, char type) {
+		char h[TAR_BLOCK];
+		memset(h, 0, sizeof(h));
+		memcpy(h, name.data(), name.size() < 100 ? name.size() : 100);
+		octal(h + 100, 8, 0644);
+		octal(h + 108, 8, 0);
+		octal(h + 116, 8, 0);
+		octal(h + 124, 12, size < 077777777777ULL ? size : 0);
+		octal(h + 136, 12, (unsigned long long)mMtime);
+		h[156] = type;
+		memcpy(h + 257, "ustar", 6);
+		memcpy(h + 263, "00", 2);
+		memcpy(h + 345, prefix.data(), prefix.size() < 155 ? prefix.size() : 155);
+		memset(h + 148, ' ', 8);
+		unsigned sum = 0;
+		for (size_t i = 0; i < sizeof(h); i++) sum += (unsigned char)h[i];
+		snprintf(h + 148, 8, "%06o", sum);
+		h[155] = ' ';
+		put(h, sizeof(h));
+	}
+	// "<len> key=value\n", len counting itself
+	static std::string paxRecord(const std::string &key, const std::string &value) {
+		size_t n = key.size() + value.size() + 3, len = n;
+		while (std::to_string(len).size() + n != len) len = std::to_string(len).size() + n;
+		return std::to_string(len) + " " + key + "=" + value + "\n";
+	}
+
+	public:
+	TarSink() : mOut(NULL),
+#if ZLIB
+		mGz(NULL),
+#endif
+		mBuf(4 << 20), mMtime(time(NULL)), mOk(true), mCount(0) {}
+	~TarSink() { finish(); }
+
+	// path "-" for stdout (given as fd, the rest of stdout may be redirected)
+	bool open(const std::string &path, bool gzip, int fd = -1) {
+		if (fd < 0) {
+			mPath = path;
+			mTmp = tmpPath(path);
+		}
+		mOut = (fd >= 0) ? fdopen(fd, "wb") : fopen(mTmp.c_str(), "wb");
+		if (mOut == NULL) return false;
+		setvbuf(mOut, mBuf.data(), _IOFBF, mBuf.size());
+		if (gzip) {
+#if ZLIB
+			fflush(mOut);
+			mGz = gzdopen(dup(fileno(mOut)), "wb6");
+			if (mGz == NULL) return false;
+			gzbuffer(mGz, 1 << 20);
+#else
+			std::cerr << "Error: built without zlib, no gzip" << std::endl;
+			return false;
+#endif
+		}
+		return true;
+	}
+	// a file of pieces at path
+	bool add(const std::string &path, const std::vector<piece_t> &pieces) {
+		std::string p = path;
+		std::replace(p.begin(), p.end(), '\\', '/');
+		size_t s = p.find_first_not_of('/');
+		p.erase(0, s == string::npos ? p.size() : s);
+		unsigned long long size = 0;
+		for (const piece_t &pc : pieces) size += pc.len;
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		// ustar: name up to 100, or a prefix up to 155 split at a '/', else PAX
+		std::string name = p, prefix;
+		if (p.size() > 100) {
+			size_t cut = p.rfind('/', 155);
+			if (cut != string::npos && cut > 0 && p.size() - cut - 1 <= 100) {
+				prefix = p.substr(0, cut);
+				name = p.substr(cut + 1);
+			}
+		}
+		if (name.size() > 100 || size >= 077777777777ULL) {
+			std::string pax = paxRecord("path", p);
+			if (size >= 077777777777ULL) pax += paxRecord("size", std::to_string(size));
+			header("PaxHeaders/" + p.substr(p.size() > 80 ? p.size() - 80 : 0), "", pax.size(), 'x');
+			put(pax.data(), pax.size());
+			pad(pax.size());
+			name = p.size() > 100 ? p.substr(p.size() - 100) : p;	// also PAX for the size only
+			prefix.clear();
+		}
+		header(name, prefix, size, '0');
+		for (const piece_t &pc : pieces) put(pc.p, pc.len);
+		pad(size);
+		mCount++;
+		return mOk;
+	}
+	int count() { return mCount; }
+	// end of archive; true if all is written
+	bool finish() {
+		if (mOut == NULL) return mOk;
+		static const char zeros[2 * TAR_BLOCK] = {0};
+		put(zeros, sizeof(zeros));
+#if ZLIB
+		if (mGz && gzclose(mGz) != Z_OK) mOk = false;
+		mGz = NULL;
+#endif
+		if (fclose(mOut) != 0) mOk = false;
+		if (!mTmp.empty() && !replaceFile(mTmp, mPath, mOk)) mOk = false;
+		mOut = NULL;
+		return mOk;
+	}
+}; // class TarSink
+
+// gzip magic at the start of file, e.g. .dsx.gz
+inline bool isGzipFile(const std::string &file) {
+	unsigned char magic[2] = {0, 0};
+	FILE *fp = fopen(file.c_str(), "rb");
+	if (fp == NULL) return false;
+	size_t n = fread(magic, 1, 2, fp);
+	fclose(fp);
+	return n == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+}
+
+#if ZLIB
+/*
+ * Gzip input: a thread inflates GZ_CHUNK blocks ahead, up to GZ_AHEAD of them, while
+ * read() hands them to the parser, so inflating and parsing overlap. Input that is
+ * not gzip passes through as is (zlib transparent mode).
+ */
+#define GZ_CHUNK (1 << 20)
+#define GZ_AHEAD 4
+class GzReader {
+	private:
+	gzFile mGz;
+	std::thread mThread;
+	std::mutex mMutex;
+	std::condition_variable mCond;
+	std::deque<std::string> mFull;	// inflated, not read yet
+	std::string mCur;
+	size_t mPos;
+	bool mEof, mError, mStop;
+
+	void run() {
+		for (;;) {
+			std::string chunk(GZ_CHUNK, '\0');
+			int n = gzread(mGz, &chunk[0], GZ_CHUNK);
+			std::unique_lock<std::mutex> lock(mMutex);
+			if (n <= 0) {
+				int err = Z_OK;
+				gzerror(mGz, &err);	// a truncated file ends with Z_BUF_ERROR
+				mError = (n < 0 || err != Z_OK);
+				mEof = true;
+				mCond.notify_all();
+				return;
+			}
+			chunk.resize(n);
+			mCond.wait(lock, [this]() { return mFull.size() < GZ_AHEAD || mStop; });
+			if (mStop) return;
+			mFull.push_back(std::move(chunk));
+			mCond.notify_all();
+		}
+	}
+
+	public:
+	GzReader() : mGz(NULL), mPos(0), mEof(false), mError(false), mStop(false) {}
+	~GzReader() {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStop = true;
+			mCond.notify_all();
+		}
+		if (mThread.joinable()) mThread.join();
+		if (mGz) gzclose(mGz);
+	}
+	// takes fd, closed with the reader
+	bool open(int fd) {
+		mGz = gzdopen(fd, "rb");
+		if (mGz == NULL) return false;
+		gzbuffer(mGz, 1 << 18);
+		mThread = std::thread(&GzReader::run, this);
+		return true;
+	}
+	// up to size bytes into buf, 0 at the end
+	size_t read(char *buf, size_t size) {
+		if (mPos == mCur.size()) {
+			std::unique_lock<std::mutex> lock(mMutex);
+			mCond.wait(lock, [this]() { return !mFull.empty() || mEof; });
+			if (mFull.empty()) return 0;
+			mCur = std::move(mFull.front());
+			mFull.pop_front();
+			mPos = 0;
+			mCond.notify_all();
+		}
+		size_t n = std::min(size, mCur.size() - mPos);
+		memcpy(buf, mCur.data() + mPos, n);
+		mPos += n;
+		return n;
+	}
+	bool error() {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mError;
+	}
+}; // class GzReader
+#endif
+
+// position of type in comp_types, the order of a composed .dsx
+inline size_t compTypeOrder(const std::string &type) {
+	const comp_t *ct = findCompType(type);
+	return ct ? ct - comp_types.data() : comp_types.size();
+}
+
+class Collection {
+	private:
+	std::string mBody0;	// file content, when read by readFile()
+	std::string mFilename;
+
+	// input as parsed: the mapping of mapFile(), or mBody0. Components point into it.
+	const char *mData;
+	size_t mSize;
+	void *mMap;
+	int mFd;		// input file, with mMap
+	bool mCopyRange;
+	bool mStrip;		// --strip-binaries
+	bool mXml;		// an XML export, see streamXml()
+	std::string mFooter;	// XML: end tag of the root, after each component
+	std::string mExt;	// of the files written
+
+	Selection *mSel;	// components to take, NULL for all
+	const CompTypeTable *mTypes;	// types handled, NULL for the defaults
+	StringPool mPool;	// types and categories of the components
+	Stats *mStats;		// counts of the run, NULL for none
+	TarSink *mTar;		// --tar: files written into it, NULL for a tree
+
+	std::string mHeader;
+	span_t mHeaderSpan;	// in mData, not for stream()
+	// Components are stored in mArena, a few large chunks instead of an allocation
+	// each, freed in one go with the collection. mComponents points into it.
+	std::deque<Component> mArena;
+	vector<Component*> mComponents;
+
+	int mOfs_curr;
+	bool mIncomplete;	// a block still open at the end of the input
+	double mParseSecs;
+	size_t mScanned;	// by last parse(), less than mSize if it stopped early
+
+	public:
+	Collection(const char * osFile) : mData(NULL), mSize(0), mMap(NULL), mFd(-1), mCopyRange(false), mStrip(false), mXml(false), mExt(".dsx"), mSel(NULL), mTypes(NULL), mStats(NULL), mTar(NULL), mIncomplete(false), mParseSecs(0), mScanned(0) {
+		mHeaderSpan.ofs = mHeaderSpan.len = 0;
+		mBody0.clear();
+		mFilename = osFile;
+	}
+	Collection() : mData(NULL), mSize(0), mMap(NULL), mFd(-1), mCopyRange(false), mStrip(false), mXml(false), mExt(".dsx"), mSel(NULL), mTypes(NULL), mStats(NULL), mTar(NULL), mIncomplete(false), mParseSecs(0), mScanned(0) {
+		mHeaderSpan.ofs = mHeaderSpan.len = 0;
+		mBody0.clear();
+	}
+	// components hold views into mData, no copies
+	Collection(const Collection &) = delete;
+	Collection & operator=(const Collection &) = delete;
+	~Collection() {
+#ifndef _WIN32
+		if (mMap) munmap(mMap, mSize);
+		if (mFd >= 0) close(mFd);
+#endif
+	}
+
+	// memory for a split of an input of size bytes: the input and, guessed at one
+	// per 2 KB, the components
+	static size_t memoryNeeded(size_t size) {
+		return size + size / 2048 * (sizeof(Component) + 64);
+	}
+	const vector<Component*> & getComponents() {
+		return mComponents;
+	}
+	string getHeader() {
+		return mHeader;
+	}
+	const std::string & header() { return mHeader; }
+	int count () {
+		return mComponents.size();
+	}
+	size_t bytes() {
+		return mSize;
+	}
+	// strings of the components, for copies of them made outside
+	StringPool & pool() { return mPool; }
+	// of the files written, ".dsx", or ".xml" for an XML export
+	const std::string & ext() { return mExt; }
+	size_t scanned() {
+		return mScanned;
+	}
+	// the last parse or stream ended in a block, the input is cut or not a .dsx
+	bool incomplete() { return mIncomplete; }
+	void unclosed(const std::string &tag) {
+		mIncomplete = true;
+		std::cerr << "Error: " << (mFilename.empty() ? std::string("<stdin>") : mFilename) << ": block " << tag
+			<< " not closed at the end, input incomplete" << std::endl;
+	}
+	std::string pack0(Component *c) {
+		if (DSXCORE_DEBUG) std::cout <<" pack0: "<< c->getType() <<", "<< c->getName() <<std::endl;
+		if (mXml) return mHeader + c->getBody() + mFooter;
+		return mHeader + c->pack1() ;
+	}
+	// pack0() as pieces for writeFile(), without copies
+	void pack0(Component *c, std::vector<piece_t> &out) {
+		piece_t header = {mHeader.data(), mHeader.size(), -1};
+		out.push_back(header);
+		size_t i = out.size();
+		if (mXml) {
+			c->bodyPieces(out);
+			piece_t footer = {mFooter.data(), mFooter.size(), -1};
+			out.push_back(footer);
+			return;
+		}
+		c->pack1(out);
+		// body of a mapped input is in the input file as well
+		for (; mMap && i < out.size(); i++) {
+			if (out[i].p >= mData && out[i].p < mData + mSize) out[i].srcOfs = out[i].p - mData;
+		}
+	}
+	// parse data of the caller instead of a file, kept by it for the collection's life
+	void setData(const char *data, size_t size) {
+		mData = data;
+		mSize = size;
+	}
+	// read file, all-in-one dsx file
+	bool readFile(){
+		try {
+			std::ifstream ifs(mFilename, std::ifstream::binary | std::ifstream::in);
+			ifs.seekg(0, std::ios::end);
+			mBody0.resize(ifs.tellg());
+			ifs.seekg(0, std::ios::beg);
+			ifs.read(&mBody0[0], mBody0.size());
+			if ((size_t)ifs.gcount() != mBody0.size()) return false;
+			ifs.close();
+		} catch(const std::exception &e) {
+			return false;
+		}
+		mData = mBody0.data();
+		mSize = mBody0.size();
+
+		return true;
+	}
+	// map file read-only instead of reading it, fall back to readFile() where
+	// mmap is not available (Windows) or not possible (empty file, pipe, ...)
+	bool mapFile() {
+#ifndef _WIN32
+		int fd = open(mFilename.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+
+		struct stat f_stat;
+		if (fstat(fd, &f_stat) != 0 || !S_ISREG(f_stat.st_mode) || f_stat.st_size == 0) {
+			close(fd);
+			return readFile();
+		}
+		void *p = mmap(NULL, f_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED) {
+			close(fd);
+			return readFile();
+		}
+		mFd = fd;	// kept for copyRange()
+		madvise(p, f_stat.st_size, MADV_SEQUENTIAL);
+
+		mMap = p;
+		mData = (const char *)p;
+		mSize = f_stat.st_size;
+		return true;
+#else
+		return readFile();
+#endif
+	}
+	// write file, one component per file
+	// safe to call from several threads at once, messages go to log
+	bool writeFile(std::string path, std::string filename, std::string content, std::ostream &log = std::cout) {
+		std::vector<piece_t> pieces(1);
+		pieces[0].p = content.data();
+		pieces[0].len = content.size();
+		pieces[0].srcOfs = -1;
+		return writeFile(path, filename, pieces, log);
+	}
+	bool ensureDir(const std::string &path, std::ostream &log) {
+		struct stat f_stat;
+
+		if (stat(path.c_str(), &f_stat) != 0) {
+			boost::system::error_code ec;
+			if (boost::filesystem::create_directories(path, ec) && mStats) mStats->dirCreated();
+			// another writer may have created it meanwhile
+			if (stat(path.c_str(), &f_stat) != 0) {
+				std::string msg = string_format("Error: Can't create directory %s", path.c_str());
+				log << " Failed." << msg << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+	// file content given as pieces, written with one writev() or, for pieces that are
+	// in the input file and with copyRange(true), copied file to file in the kernel.
+	// Written to a temporary file renamed into place, the old file stays if it fails
+	bool writeFile(std::string path, std::string filename, const std::vector<piece_t> &pieces, std::ostream &log = std::cout) {
+		if (mTar) return mTar->add(path + Component::getDirSeptChar() + filename + mExt, pieces);
+		if (!ensureDir(path, log)) return false;
+		std::string fullPath = path + Component::getDirSeptChar() + filename + mExt;
+		std::string tmp = tmpPath(fullPath);
+		
+#ifndef _WIN32
+		int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		if (fd < 0) return false;
+		bool ok = writePieces(fd, pieces);
+		if (close(fd) != 0) ok = false;
+#else
+		std::ofstream ofs(tmp, std::ifstream::binary | std::ifstream::out);
+		for (const piece_t &pc : pieces) ofs.write(pc.p, pc.len);
+		ofs.close();
+		bool ok = !ofs.fail();
+#endif
+		return replaceFile(tmp, fullPath, ok);
+	}
+	// path/filename.dsx as hard link to an existing file, false if not possible
+	bool linkFile(const std::string &from, std::string path, std::string filename, std::ostream &log = std::cout) {
+		if (!ensureDir(path, log)) return false;
+		std::string to = path + Component::getDirSeptChar() + filename + mExt;
+		std::string tmp = tmpPath(to);
+		boost::system::error_code ec;
+		boost::filesystem::create_hard_link(from, tmp, ec);
+		if (ec) return false;
+		bool ok = replaceFile(tmp, to, true);
+		std::remove(tmp.c_str());	// still there if to was the same file already
+		return ok;
+	}
+#ifndef _WIN32
+	bool writePieces(int fd, const std::vector<piece_t> &pieces) {
+		std::vector<struct iovec> iov;
+		size_t i = 0;
+		while (i < pieces.size()) {
+			if (mCopyRange && pieces[i].srcOfs >= 0 && copyRange(fd, pieces[i])) {
+				i++;
+				continue;
+			}
+			// in-memory pieces up to the next copyable one, in one go
+			iov.clear();
+			for (; i < pieces.size() && !(mCopyRange && pieces[i].srcOfs >= 0 && !iov.empty()) && iov.size() < IOV_MAX; i++) {
+				struct iovec v = {(void *)pieces[i].p, pieces[i].len};
+				iov.push_back(v);
+			}
+			for (size_t k = 0; k < iov.size(); ) {
+				ssize_t n = writev(fd, &iov[k], iov.size() - k);
+				if (n < 0) {
+					if (errno == EINTR) continue;
+					return false;
+				}
+				// short write, skip what is done
+				while (k < iov.size() && (size_t)n >= iov[k].iov_len) n -= iov[k++].iov_len;
+				if (k < iov.size()) {
+					iov[k].iov_base = (char *)iov[k].iov_base + n;
+					iov[k].iov_len -= n;
+				}
+			}
+		}
+		return true;
+	}
+	// copy a piece from the input file in the kernel, false to write it from memory
+	bool copyRange(int fd, const piece_t &pc) {
+#if defined(__linux__) && defined(SYS_copy_file_range)
+		// through syscall(), no glibc 2.27 needed (see Compatibility)
+		loff_t in = pc.srcOfs;
+		size_t done = 0;
+		while (done < pc.len) {
+			long n = syscall(SYS_copy_file_range, mFd, &in, NULL, fd, NULL, pc.len - done, 0);
+			if (n <= 0) {
+				if (n < 0 && errno == EINTR) continue;
+				// nothing copied yet: fall back to write(), unsupported fs etc.
+				if (done == 0) return false;
+				return write(fd, pc.p + done, pc.len - done) == (ssize_t)(pc.len - done);
+			}
+			done += n;
+		}
+		return true;
+#else
+		return false;
+#endif
+	}
+#endif
+	void copyRange(bool b) { mCopyRange = b && mFd >= 0; }
+
+
+	void makeComponent(Component *c, const comp_t &ct, const char *src, const span_t &sp, const std::vector<span_t> *holes = NULL) {
+		c->setBody(src, sp);
+		if (holes && !holes->empty()) c->setHoles(*holes);
+		c->setType(ct.type, mPool);
+		if (ct.name_level> 0) {
+			c->setName(c->getAttr(ct.name_level, ct.name_prefix));
+			if (DSXCORE_DEBUG) { std::cout << " name = [" << c->getName()  << "]"; }
+		}
+		if (ct.cate_level> 0) {
+			c->setCate(c->getAttr(ct.cate_level, ct.cate_prefix), mPool);
+			if (DSXCORE_DEBUG) { std::cout << " cate = [" << c->getCate()  << "]"; }
+		}
+		c->dropAttrs();
+		if (DSXCORE_DEBUG) std::cout << endl;
+	}
+	// keep c, moved into the arena
+	Component * keep(Component &c) {
+		mArena.push_back(std::move(c));
+		mComponents.push_back(&mArena.back());
+		return mComponents.back();
+	}
+	// false if all selected components are found
+	bool addComponent(const comp_t &ct, const span_t &sp, const std::vector<span_t> *holes) {
+		Component tmp;
+		Component *c = &tmp;
+		makeComponent(c, ct, mData, sp, holes);
+		if (c->getType() == "HEADER") {
+			mHeader = c->getBody();
+			mHeaderSpan = sp;
+		} else if (!mSel || mSel->ok(c)) {
+			c = keep(tmp);
+			if (mSel && mSel->found(c)) return false;
+		}
+		return true;
+	}
+	void select(Selection *sel) { mSel = (sel && !sel->empty()) ? sel : NULL; }
+	// the table is the caller's, kept while this collection is used
+	void handle(const CompTypeTable *types) { mTypes = types; }
+	const CompTypeTable & types() { return mTypes ? *mTypes : CompTypeTable::defaults(); }
+	void stats(Stats *stats) { mStats = stats; }
+	void tar(TarSink *tar) { mTar = tar; }
+	// leave the binaries of components out (--strip-binaries)
+	void stripBinaries(bool b) { mStrip = b; }
+	static bool binaryTag(const char *tag, size_t n) {
+		return (n == 9 && 0 == memcmp(tag, "DSEXECJOB", 9)) || (n == 10 && 0 == memcmp(tag, "DSBPBINARY", 10));
+	}
+
+	// parse with up to nThreads threads, 0 for one per core
+	void parse(int nThreads = 1) {
+		auto t0 = std::chrono::steady_clock::now();
+
+		if (nThreads == 0) nThreads = std::thread::hardware_concurrency();
+		// a serial scan can stop at the last name selected
+		if (mSel && mSel->canStop()) nThreads = 1;
+		if (nThreads < 2 || mSize < PARALLEL_MIN || !parseParallel(nThreads))
+			parseSerial();
+
+		mParseSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	}
+
+	// top-level block of a type handled and selected
+	bool wanted(const char *tag, size_t n) {
+		const comp_t *ct = types().find(tag, n);
+		return ct && (!mSel || mSel->typeOk(*ct));
+	}
+
+	void parseSerial() {
+		DsxScanner scanner;
+		scanner.want([this](const char *tag, size_t n) { return wanted(tag, n); });
+		if (mStrip) scanner.strip(binaryTag);
+		scanner.scan(mData, mSize, [this, &scanner](const block_t &blk) {
+			const comp_t *ct = types().find(blk.type);
+			if (ct == NULL) return;
+			if (mSel && !mSel->typeOk(*ct)) return;
+
+			if (DSXCORE_DEBUG) std::cout << "type=[" << blk.type << "]" ;
+			if (ct->entity_level == 1) {
+				if (!addComponent(*ct, blk.body, &blk.holes)) scanner.stop();
+			} else if (ct->entity_level == 2) {
+				for (const span_t &rec : blk.records) {
+					if (DSXCORE_DEBUG) { std::cout << endl << ""; }
+					if (!addComponent(*ct, rec, &blk.holes)) {
+						scanner.stop();
+						break;
+					}
+				}
+			} // level 1 vs 2.
+		});
+		mScanned = scanner.bytes();
+		if (!scanner.stopped() && scanner.depth() > 0) unclosed(scanner.openTag(0));
+	}// parseSerial()
+
+	/*
+	 * Parallel parse, in 3 rounds over all threads:
+	 *  1. split the buffer in equal ranges, collect the column 0 "BEGIN X"/"END X" lines
+	 *     of each. Serially pair them up into top-level blocks.
+	 *  2. run DsxScanner over each block, gives its DSRECORD spans and confirms the
+	 *     block boundaries of round 1.
+	 *  3. build components (attribute lookups) in chunks of PARALLEL_CHUNK, each into
+	 *     its slot, so mComponents ends up in file order.
+	 * Return false, with nothing changed, when round 2 disagrees with round 1 (odd
+	 * content at column 0), the caller then falls back to parseSerial().
+	 */
+	bool parseParallel(int nThreads) {
+		typedef struct { size_t ofs; size_t len; bool begin; } mark_t;
+
+		size_t nRange = nThreads * 4;
+		std::vector<std::vector<mark_t> > marks(nRange);
+		parallelFor(nThreads, nRange, [&](size_t r) {
+			size_t ofs = mSize * r / nRange, end = mSize * (r + 1) / nRange;
+			// first line starting in the range
+			if (ofs > 0 && mData[ofs - 1] != '\n') {
+				const char *nl = (const char *)memchr(mData + ofs, '\n', mSize - ofs);
+				ofs = nl ? nl - mData + 1 : mSize;
+			}
+			// column 0 "BE"/"EN" starting a line in the range
+			size_t lim = end < mSize ? end + 1 : mSize;
+			while (ofs < end) {
+				if (ofs > 0 || (mData[0] != 'B' && mData[0] != 'E')) {
+					ofs = findMarker(mData, ofs > 0 ? ofs : 1, lim, true);
+					if (ofs >= end) break;
+				}
+				const char *nl = (const char *)memchr(mData + ofs, '\n', mSize - ofs);
+				size_t len = (nl ? (size_t)(nl - mData) + 1 : mSize) - ofs;
+				size_t tag = lineTag(mData + ofs, len);
+				if (tag) marks[r].push_back({ofs, len, mData[ofs] == 'B'});
+				ofs += len;
+			}
+		});
+
+		std::vector<block_t> blocks;
+		bool open = false;
+		span_t tag0 = {0, 0};
+		for (const std::vector<mark_t> &range : marks) {
+			for (const mark_t &m : range) {
+				size_t t = lineTag(mData + m.ofs, m.len);
+				span_t tag = {m.ofs + t, m.len - t - strlen(DSXNEWLINE)};
+				if (!open && m.begin) {
+					open = true;
+					tag0 = tag;
+					blocks.push_back(block_t());
+					blocks.back().body.ofs = m.ofs;
+				} else if (open && !m.begin && tag.len == tag0.len &&
+						0 == memcmp(mData + tag.ofs, mData + tag0.ofs, tag.len)) {
+					open = false;
+					blocks.back().type.assign(mData + tag.ofs, tag.len);
+					blocks.back().body.len = m.ofs + m.len - blocks.back().body.ofs;
+				}
+			}
+		}
+		std::string lastOpen;
+		if (open) {
+			blocks.pop_back();	// never closed, as in parseSerial()
+			lastOpen.assign(mData + tag0.ofs, tag0.len);
+		}
+		// the others are skipped, as in parseSerial()
+		blocks.erase(std::remove_if(blocks.begin(), blocks.end(), [this](const block_t &blk) {
+			return !wanted(blk.type.data(), blk.type.size());
+		}), blocks.end());
+
+		std::atomic<bool> agree(true);
+		parallelFor(nThreads, blocks.size(), [&](size_t i) {
+			block_t &blk = blocks[i];
+			int n = 0;
+			DsxScanner scanner;
+			if (mStrip) scanner.strip(binaryTag);
+			scanner.scan(mData + blk.body.ofs, blk.body.len, [&](const block_t &b) {
+				n++;
+				if (b.body.ofs != 0 || b.body.len != blk.body.len) return;
+				blk.records = b.records;
+				for (span_t &rec : blk.records) rec.ofs += blk.body.ofs;
+				blk.holes = b.holes;
+				for (span_t &h : blk.holes) h.ofs += blk.body.ofs;
+			});
+			if (n != 1 || scanner.depth() != 0) agree = false;
+		});
+		if (!agree) return false;
+		if (!lastOpen.empty()) unclosed(lastOpen);
+
+		// slots: one per level 1 block, one per record of level 2 blocks
+		typedef struct { const comp_t *ct; span_t span; const std::vector<span_t> *holes; } slot_t;
+		std::vector<slot_t> slots;
+		for (const block_t &blk : blocks) {
+			const comp_t *ct = types().find(blk.type);
+			if (ct == NULL) continue;
+			if (mSel && !mSel->typeOk(*ct)) continue;
+			if (ct->entity_level == 1) slots.push_back({ct, blk.body, &blk.holes});
+			else if (ct->entity_level == 2)
+				for (const span_t &rec : blk.records) slots.push_back({ct, rec, &blk.holes});
+		}
+
+		std::vector<Component> comps(slots.size());
+		parallelFor(nThreads, (slots.size() + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK, [&](size_t k) {
+			for (size_t i = k * PARALLEL_CHUNK; i < slots.size() && i < (k + 1) * PARALLEL_CHUNK; i++)
+				makeComponent(&comps[i], *slots[i].ct, mData, slots[i].span, slots[i].holes);
+		});
+
+		for (Component &c : comps) {
+			if (c.getType() == "HEADER") {
+				mHeader = c.getBody();
+				mHeaderSpan = c.getSpan();
+			} else if (!mSel || mSel->ok(&c)) {
+				Component *k = keep(c);
+				if (mSel) mSel->found(k);	// all parsed already, no stop
+			}
+		}
+		mScanned = mSize;
+		return true;
+	}// parseParallel()
+
+	/*
+	 * Sidecar index, <file>.dsxidx: where each component is in the .dsx, so a later
+	 * run can take the components from it and skip parse(). Valid for the .dsx of
+	 * the size, mtime (in ns where the system keeps them) and header recorded, parsed for
+	 * the types handled now. The header has the export time, a new export of the same
+	 * size within the mtime resolution still differs in it. Native byte order:
+	 * 	"DSXIDX3\0", u64 size, i64 mtime ns, str types (CompTypeTable::key()),
+	 * 	u64 header offset, u64 header length, u64 header hash, u32 count,
+	 * 	count x { str type, str name, str category, u64 offset, u64 length, u64 hash }
+	 * str is u16 length and bytes.
+	 */
+	static std::string indexPath(const std::string &file) {
+		size_t n = file.size();
+		if (n > 4 && file.compare(n - 4, 4, ".dsx") == 0) return file.substr(0, n - 4) + ".dsxidx";
+		return file + ".dsxidx";
+	}
+	static int64_t mtimeNs(const struct stat &f_stat) {
+#ifdef _WIN32
+		return (int64_t)f_stat.st_mtime * 1000000000;
+#else
+		return (int64_t)f_stat.st_mtim.tv_sec * 1000000000 + f_stat.st_mtim.tv_nsec;
+#endif
+	}
+	uint64_t headerHash(uint64_t ofs, uint64_t len) {
+		Hash64 h;
+		h.add(mData + ofs, len);
+		return h.value();
+	}
+	bool writeIndex() {
+		struct stat f_stat;
+		if (stat(mFilename.c_str(), &f_stat) != 0) return false;
+		if (mHeaderSpan.len == 0) return false;
+
+		std::string idx("DSXIDX3", 8);
+		putIdx(idx, (uint64_t)f_stat.st_size);
+		putIdx(idx, mtimeNs(f_stat));
+		putIdx(idx, types().key());
+		putIdx(idx, (uint64_t)mHeaderSpan.ofs);
+		putIdx(idx, (uint64_t)mHeaderSpan.len);
+		putIdx(idx, headerHash(mHeaderSpan.ofs, mHeaderSpan.len));
+		putIdx(idx, (uint32_t)mComponents.size());
+		for (Component *c : mComponents) {
+			putIdx(idx, c->getType());
+			putIdx(idx, c->getName());
+			putIdx(idx, c->getCate());
+			putIdx(idx, (uint64_t)c->getSpan().ofs);
+			putIdx(idx, (uint64_t)c->getSpan().len);
+			putIdx(idx, c->getHash());
+		}
+
+		std::string path = indexPath(mFilename), tmp = tmpPath(path);
+		bool ok;
+		{
+			std::ofstream ofs(tmp, std::ofstream::binary);
+			ofs.write(idx.data(), idx.size());
+			ofs.close();	// the last of it is written here
+			ok = !ofs.fail();
+		}
+		return replaceFile(tmp, path, ok);
+	}
+	// take the components from the index instead of parse(). False if there is
+	// none, or it does not match the input (size, mtime, header, spans), nothing
+	// loaded then.
+	bool loadIndex() {
+		struct stat f_stat;
+		if (stat(mFilename.c_str(), &f_stat) != 0 || (uint64_t)f_stat.st_size != mSize) return false;
+
+		std::ifstream ifs(indexPath(mFilename), std::ifstream::binary);
+		std::string idx((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+		size_t pos = 8;
+		uint64_t size = 0, hOfs = 0, hLen = 0, hHash = 0;
+		int64_t mtime = 0;
+		uint32_t count = 0;
+		std::string key;
+		if (idx.size() < 8 || idx.compare(0, 8, std::string("DSXIDX3", 8)) != 0 ||
+			!getIdx(idx, pos, size) || !getIdx(idx, pos, mtime) ||
+			!getIdx(idx, pos, key) || key != types().key() ||
+			!getIdx(idx, pos, hOfs) || !getIdx(idx, pos, hLen) || !getIdx(idx, pos, hHash) ||
+			!getIdx(idx, pos, count) ||
+			size != mSize || mtime != mtimeNs(f_stat) || hOfs + hLen > mSize ||
+			hHash != headerHash(hOfs, hLen))
+			return false;
+
+		size_t n0 = mArena.size();
+		for (uint32_t i = 0; i < count; i++) {
+			std::string type, name, cate;
+			uint64_t ofs = 0, len = 0, hash = 0;
+			if (!getIdx(idx, pos, type) || !getIdx(idx, pos, name) || !getIdx(idx, pos, cate) ||
+				!getIdx(idx, pos, ofs) || !getIdx(idx, pos, len) || !getIdx(idx, pos, hash) ||
+				ofs + len > mSize || types().find(type) == NULL) {
+				mArena.resize(n0);
+				mComponents.resize(n0);
+				return false;
+			}
+			span_t sp = {(size_t)ofs, (size_t)len};
+			Component c(mData, sp, type, name, cate, mPool);
+			c.setHash(hash);
+			if (!mSel || mSel->ok(&c)) {
+				Component *k = keep(c);
+				if (mSel) mSel->found(k);
+			}
+		}
+
+		mHeaderSpan.ofs = hOfs;
+		mHeaderSpan.len = hLen;
+		mHeader.assign(mData + hOfs, hLen);
+#ifndef _WIN32
+		// components are read where needed, not front to back
+		if (mMap) madvise(mMap, mSize, MADV_RANDOM);
+#endif
+		return true;
+	}
+	template<typename T>
+	static void putIdx(std::string &idx, T v) { idx.append((const char *)&v, sizeof(v)); }
+	static void putIdx(std::string &idx, const std::string &str) {
+		putIdx(idx, (uint16_t)str.size());
+		idx.append(str);
+	}
+	template<typename T>
+	static bool getIdx(const std::string &idx, size_t &pos, T &v) {
+		if (pos + sizeof(v) > idx.size()) return false;
+		memcpy(&v, idx.data() + pos, sizeof(v));
+		pos += sizeof(v);
+		return true;
+	}
+	static bool getIdx(const std::string &idx, size_t &pos, std::string &str) {
+		uint16_t n;
+		if (!getIdx(idx, pos, n) || pos + n > idx.size()) return false;
+		str.assign(idx.data() + pos, n);
+		pos += n;
+		return true;
+	}
+
+	// bytes scanned per second, of last parse()
+	double parseMBps() {
+		return (mParseSecs > 0) ? mScanned / mParseSecs / (1024.0 * 1024.0) : 0;
+	}
+	double parseSecs() { return mParseSecs; }
+
+	// Parse input pulled in chunks through read(buf, size), which returns 0 at the end.
+	// Each component is handed to onComponent as soon as its END line arrives and is
+	// deleted right after, it only stays valid during the call. Buffered are the header,
+	// the lines of the block being built, and at most one chunk.
+	// Return number of components.
+	int stream(std::function<size_t(char *, size_t)> read, std::function<void(Component *)> onComponent) {
+		const size_t CHUNK = 1 << 20;
+		std::string buf;	// input bytes [bufOfs, bufOfs + buf.size())
+		size_t bufOfs = 0;
+		size_t pos = 0;		// relative to buf, lines before it are scanned
+		int cnt = 0;
+		auto t0 = std::chrono::steady_clock::now();
+
+		// an XML export goes to streamXml()
+		buf.resize(CHUNK);
+		buf.resize(read(&buf[0], CHUNK));
+		size_t i = (buf.size() >= 3 && 0 == buf.compare(0, 3, "\xef\xbb\xbf")) ? 3 : 0;
+		while (i < buf.size() && (buf[i] == ' ' || buf[i] == '\t' || buf[i] == '\r' || buf[i] == '\n')) i++;
+		if (i < buf.size() && buf[i] == '<') return streamXml(buf, read, onComponent);
+
+		DsxScanner scanner;
+		scanner.streamRecords(true);
+		scanner.want([this](const char *tag, size_t n) { return wanted(tag, n); });
+		if (mStrip) scanner.strip(binaryTag, true);
+		auto onBlock = [&](const block_t &blk) {
+			const comp_t *ct = types().find(blk.type);
+			if (ct == NULL) return;
+			if (mSel && !mSel->typeOk(*ct)) return;
+
+			std::vector<span_t> spans;
+			if (ct->entity_level == 1 && blk.closed) spans.push_back(blk.body);
+			else if (ct->entity_level == 2) spans = blk.records;
+			for (span_t sp : spans) {
+				sp.ofs -= bufOfs;
+				Component tmp, *c = &tmp;
+				makeComponent(c, *ct, buf.data(), sp);
+				if (c->getType() == "HEADER") {
+					mHeader = c->getBody();
+				} else if (!mSel || mSel->ok(c)) {
+					onComponent(c);
+					cnt++;
+					if (mSel && mSel->found(c)) scanner.stop();
+				}
+				if (scanner.stopped()) break;
+			}
+		};
+
+		bool eof = false;
+		while (!eof && !scanner.stopped()) {
+			size_t have = buf.size();
+			buf.resize(have + CHUNK);
+			size_t got = read(&buf[have], CHUNK);
+			buf.resize(have + got);
+			eof = (got == 0);
+
+			// a partial line is left for more; binaries are dropped as they are skipped
+			size_t cut;
+			for (;;) {
+				pos = scanner.feed(buf.data(), buf.size(), pos, bufOfs, eof, onBlock);
+				if (!scanner.cutFrom(cut)) break;
+				buf.erase(cut - bufOfs, bufOfs + pos - cut);
+				pos = cut - bufOfs;
+				if (!scanner.cut() || pos >= buf.size() || scanner.stopped()) break;
+			}
+
+			// keep what a later callback still needs: a level 1 component from its
+			// BEGIN line, a level 2 one from its DSRECORD line, nothing otherwise.
+			size_t keep = bufOfs + pos;
+			if (scanner.depth() > 0 && !scanner.skipping()) {
+				const comp_t *ct = types().find(scanner.openTag(0));
+				if (ct && ct->entity_level == 1) keep = scanner.openStart(0);
+				else if (ct && ct->entity_level == 2 && scanner.depth() > 1) keep = scanner.openStart(1);
+			}
+			buf.erase(0, keep - bufOfs);
+			pos -= keep - bufOfs;
+			bufOfs = keep;
+		}
+		if (!scanner.stopped() && scanner.depth() > 0) unclosed(scanner.openTag(0));
+		mSize = mScanned = scanner.bytes();
+		mParseSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		return cnt;
+	}
+
+		
+		
+
+	/*
+	 * stream() of an XML export: under the root (<DSExport>), each element of a type
+	 * (<Job>, <Routine>, ...) is a component, and each <Record> of a group element
+	 * (<Routines>, ...) one, wrapped in the group tags. Name is the Identifier, the
+	 * category the first <Property Name="Category">. Files are the header (all up to
+	 * the end of <Header>), the element and the end tag of the root. Buffered are the
+	 * header and the element being read, the bytes of the rest are dropped as read.
+	 * buf holds the input read so far.
+	 */
+	int streamXml(std::string buf, std::function<size_t(char *, size_t)> read, std::function<void(Component *)> onComponent) {
+		const size_t CHUNK = 1 << 20;
+		size_t bufOfs = 0;
+		size_t pos = 0;
+		int cnt = 0;
+		auto t0 = std::chrono::steady_clock::now();
+		mXml = true;
+		mExt = ".xml";
+		size_t nlAt = buf.find('\n');
+		std::string nl = (nlAt != string::npos && nlAt > 0 && buf[nlAt-1] == '\r') ? DSXNEWLINE : "\n";
+
+		XmlScanner scanner;
+		bool header = false;
+		size_t rootEnd = 0;		// input offset past the root start tag
+		const xml_type_t *group = NULL;
+		std::string groupTag, groupName, groupIndent;	// the indent of its start tag, for the end tag
+		const comp_t *ct = NULL;	// of the component being read
+		size_t start = string::npos;	// its first tag
+		int compDepth = 0;
+		std::string name, cate, *prop = NULL;	// prop: Property being read into
+		// the tag at ofs, from the start of its line if only blanks are before it
+		auto indented = [&](const char *b, size_t ofs) {
+			size_t i = ofs;
+			while (i > bufOfs && (b[i-1] == ' ' || b[i-1] == '\t')) i--;
+			return (i > bufOfs && b[i-1] == '\n') ? i : ofs;
+		};
+		auto emit = [&](const xml_tag_t &t, const char *b) {
+			std::string body;
+			if (compDepth == 3) body = groupTag + nl;
+			body.append(b + start, t.span.ofs + t.span.len - start);
+			body += nl;
+			if (compDepth == 3) body += groupIndent + "</" + groupName + ">" + nl;
+			std::string dsxCate;	// \Jobs\X as in a .dsx
+			for (char ch : cate) {
+				dsxCate += ch;
+				if (ch == '\\') dsxCate += ch;
+			}
+			span_t sp = {0, body.size()};
+			Component c;
+			c.setBody(body.data(), sp);
+			c.setType(ct->type, mPool);
+			c.setName(name);
+			c.setCate(dsxCate, mPool);
+			if (!mSel || mSel->ok(&c)) {
+				onComponent(&c);
+				cnt++;
+				if (mSel && mSel->found(&c)) scanner.stop();
+			}
+			start = string::npos;
+		};
+		auto onTag = [&](const xml_tag_t &t) {
+			const char *b = buf.data() - bufOfs;	// at input offset 0
+			if (t.depth == 1) {
+				if (t.kind != XML_END) {
+					rootEnd = t.span.ofs + t.span.len;
+					mFooter = "</" + std::string(t.name, t.nameLen) + ">" + nl;
+				}
+				return;
+			}
+			if (!header && t.depth == 2) {
+				// up to the end of <Header>, or of the root start tag without one
+				bool h = (t.nameLen == 6 && 0 == memcmp(t.name, "Header", 6));
+				if (h && t.kind == XML_START) return;
+				mHeader.assign(b, h ? t.span.ofs + t.span.len : rootEnd);
+				mHeader += nl;
+				header = true;
+				if (h) return;
+			}
+			if (start == string::npos) {
+				const xml_type_t *x = (t.depth == 2) ? findXmlType(t.name, t.nameLen) : NULL;
+				if (t.depth == 2 && t.kind == XML_END) {
+					group = NULL;
+					return;
+				}
+				if (x && x->group) {
+					if (t.kind == XML_START) {
+						group = x;
+						size_t from = indented(b, t.span.ofs);
+						groupTag.assign(b + from, t.span.ofs + t.span.len - from);
+						groupName.assign(t.name, t.nameLen);
+						groupIndent.assign(b + from, t.span.ofs - from);
+					}
+					return;
+				}
+				if (group && t.depth == 3 && t.kind != XML_END && t.nameLen == 6 && 0 == memcmp(t.name, "Record", 6)) x = group;
+				else if (!x || t.depth != 2) return;
+				ct = types().find(x->type);
+				if (ct == NULL || !wanted(ct->type.data(), ct->type.size())) return;
+				start = indented(b, t.span.ofs);
+				compDepth = t.depth;
+				name = xmlAttr(t, "Identifier");
+				cate.clear();
+				prop = NULL;
+				if (t.kind == XML_EMPTY) emit(t, b);
+				return;
+			}
+			if (t.kind == XML_START && t.nameLen == 8 && 0 == memcmp(t.name, "Property", 8)) {
+				std::string pn = xmlAttr(t, "Name");
+				if (pn == "Category" && cate.empty()) prop = &cate;
+				else if (pn == "Name" && name.empty()) prop = &name;
+			} else if (t.kind == XML_END && prop) {
+				*prop = xmlUnescape(b + scanner.textStart(), t.span.ofs - scanner.textStart());
+				prop = NULL;
+			} else if (t.kind == XML_END && t.depth == compDepth) {
+				emit(t, b);
+			}
+		};
+
+		bool eof = false;
+		for (;;) {
+			pos = scanner.feed(buf.data(), buf.size(), pos, bufOfs, eof, onTag);
+			if (eof || scanner.stopped()) break;
+			// keep the header until it is complete, the component being read, and
+			// the blanks that may indent the next one
+			size_t keep = !header ? 0 : (start != string::npos ? start : scanner.textStart());
+			buf.erase(0, keep - bufOfs);
+			pos -= keep - bufOfs;
+			bufOfs = keep;
+			size_t have = buf.size();
+			buf.resize(have + CHUNK);
+			size_t got = read(&buf[have], CHUNK);
+			buf.resize(have + got);
+			eof = (got == 0);
+		}
+		if (!scanner.stopped() && (scanner.error() || scanner.depth() != 0)) {
+			mIncomplete = true;
+			std::cerr << "Error: XML not complete or not well formed, at byte " << scanner.bytes() << std::endl;
+		}
+		mSize = mScanned = scanner.bytes();
+		mParseSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		return cnt;
+	}
+
+	// write to files, one per component under path. Return number written.
+	int dumpToFiles(string path) {
+		int n = 0;
+		for (Component *c : mComponents) {
+			std::vector<piece_t> pieces;
+			pack0(c, pieces);
+			if (writeFile(path + c->getPath(), c->getName(), pieces)) n++;
+		}
+		return n;
+	}
+	/*
+	 * Keep only the components named (patterns, * and ?) and what they refer to, to
+	 * the end: the parameter sets, routines and shared containers of Component::refs(),
+	 * and theirs. Bodies are looked into as they are reached, not all. Names not
+	 * found and references to nothing in the export are told to log. Return the
+	 * number kept, in file order; -1, nothing changed, if a name matches nothing.
+	 */
+	int closure(const std::vector<std::string> &names, std::ostream &log) {
+		std::multimap<std::string, size_t> byName;	// type \0 name
+		for (size_t i = 0; i < mComponents.size(); i++)
+			byName.insert(std::make_pair(mComponents[i]->getType() + '\0' + mComponents[i]->getName(), i));
+
+		std::vector<bool> in(mComponents.size(), false);
+		std::vector<size_t> todo;
+		bool roots = true;
+		for (const std::string &n : names) {
+			bool hit = false;
+			for (size_t i = 0; i < mComponents.size(); i++) {
+				if (!globMatch(n.c_str(), mComponents[i]->getName().c_str())) continue;
+				hit = true;
+				if (!in[i]) todo.push_back(i);
+				in[i] = true;
+			}
+			if (!hit) {
+				log << "Error: --closure " << n << " not found" << std::endl;
+				roots = false;
+			}
+		}
+		if (!roots) return -1;
+		std::set<std::string> missing;
+		while (!todo.empty()) {
+			Component *c = mComponents[todo.back()];
+			todo.pop_back();
+			std::vector<ref_t> refs;
+			c->refs(refs, types());
+			for (const ref_t &r : refs) {
+				auto range = byName.equal_range(r.ct->type + '\0' + r.name);
+				if (range.first == range.second && r.sure && missing.insert(r.ct->type + ' ' + r.name).second)
+					log << "Not in export: " << r.ct->type << " " << r.name << " (used by " << c->getName() << ")" << std::endl;
+				for (auto it = range.first; it != range.second; ++it) {
+					if (in[it->second]) continue;
+					in[it->second] = true;
+					todo.push_back(it->second);
+				}
+			}
+		}
+		std::vector<Component *> kept;
+		for (size_t i = 0; i < mComponents.size(); i++)
+			if (in[i]) kept.push_back(mComponents[i]);
+		mComponents.swap(kept);
+		return mComponents.size();
+	}
+
+	// add a component; its body must stay valid while this collection is used
+	int merge(Component x) {
+		keep(x);
+		return mComponents.size();
+	}
+	// write to one file, Path/filename or "-" for stdout, components grouped by
+	// type. Return number written, -1 on error.
+	int composeToFile(string Path, string filename) {
+		std::vector<Component*> comps(mComponents);
+		std::stable_sort(comps.begin(), comps.end(), [](Component *a, Component *b) {
+			return compTypeOrder(a->getType()) < compTypeOrder(b->getType());
+		});
+		Composer out;
+		if (!out.open((filename == "-" || Path.empty()) ? filename : Path + Component::getDirSeptChar() + filename)) return -1;
+		out.header(mHeader);
+		for (Component *c : comps) out.add(c);
+		return out.finish() ? out.count() : -1;
+	}
+	void setHeader(const std::string &header) { mHeader = header; }
+
+
+
+}; //class Collection
+
+} // namespace dsxcore
+
+#endif // DSXCORE_H
@@ -0,0 +1,178 @@
+
+/*
+
+Copyright (C) 2023, Steve Jin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * libdsxcut, see dsxcut.h: the globals of the parser (dsxcore.h), then the Export
+ * API over a Collection. Linked into the dsxcut program as well.
+ */
+
+#include "dsxcore.h"
+#include "dsxcut.h"
+
+namespace dsxcore {
+
+// component types known; which of them a Collection handles is in its CompTypeTable
+std::vector<comp_t> comp_types {
+	    {"HD", "HEADER" ,  1, 0, 0, "Identifier", "Category", true},
+	    {"JOB", "DSJOB" , 1, 1, 2, "Identifier", "Category", true},
+	    {"DT", "DSDATATYPES" , 2, 2, 2, "Identifier", "Category", false},	// not needed at runtime
+	    {"PS", "DSPARAMETERSETS" , 2,2, 2, "Identifier", "Category", true},
+	    {"TD", "DSTABLEDEFS" , 2, 2, 2, "Identifier",  "Category", false},	// not needed at runtime
+	    {"RT", "DSROUTINES" , 2, 2, 2, "Identifier",  "Category", true},
+
+	    // Assumed ... , to be confirmed/tested !!!!
+	    {"TR", "DSTRANSFORMES" , 2, 2, 2, "Identifier",  "Category", true},
+	    {"ST", "DSSTAGETYPES" , 2, 2, 2, "Identifier",  "Category", true},
+	    {"SC", "DSSHAREDCONTAINER" , 1, 1, 2, "Identifier",  "Category", true},
+
+	    // Binaries of component is explicitly excluded/ignored !!! As assumption that execution
+	    // enviroments configureation generally are not the same, therefore, compilation is requireed
+	    // after code promotion/imported. With --strip-binaries the DSEXECJOB/DSBPBINARY sub-blocks
+	    // are left out of the components as well (Collection::binaryTag()).
+};
+
+const std::pair<const char *, marker_fn> marker_kernel = markerKernels()[0];
+static const std::string empty_str;
+const std::string *EMPTY_STR = &empty_str;
+
+} // namespace dsxcore
+
+
+namespace dsxcut {
+
+using dsxcore::Collection;
+using dsxcore::Component;
+using dsxcore::piece_t;
+
+// all the state of an Export: nothing is shared with another one
+struct Export::Impl {
+	Collection coll;
+	std::vector<ComponentView> views;
+
+	Impl(const char *file) : coll(file) {}
+	Impl() {}
+	Component * component(const ComponentView &c) {
+		return (c.index < coll.getComponents().size()) ? coll.getComponents()[c.index] : NULL;
+	}
+};
+
+static Text text(const std::string &s) {
+	Text t = {s.data(), s.size()};
+	return t;
+}
+static bool fail(std::string *error, const std::string &msg) {
+	if (error) *error = msg;
+	return false;
+}
+
+Export::Export() {}
+Export::~Export() {}
+
+std::unique_ptr<Export> Export::open(const std::string &path, const Options &opt, std::string *error) {
+	std::unique_ptr<Export> e(new Export());
+	e->mImpl.reset(new Impl(path.c_str()));
+	if (dsxcore::isGzipFile(path) || dsxcore::isXmlFile(path)) {
+		fail(error, path + ": gzip and XML exports are not loaded, split them with dsxcut");
+		return NULL;
+	}
+	if (!e->mImpl->coll.mapFile()) {
+		fail(error, "can't read " + path);
+		return NULL;
+	}
+	if (!e->load(opt, error)) return NULL;
+	return e;
+}
+
+std::unique_ptr<Export> Export::openBuffer(const char *data, size_t size, const Options &opt, std::string *error) {
+	std::unique_ptr<Export> e(new Export());
+	e->mImpl.reset(new Impl());
+	e->mImpl->coll.setData(data, size);
+	if (!e->load(opt, error)) return NULL;
+	return e;
+}
+
+// parse, and a view of each component
+bool Export::load(const Options &opt, std::string *error) {
+	Collection &coll = mImpl->coll;
+	coll.stripBinaries(opt.stripBinaries);
+	coll.parse(opt.parseJobs);
+	if (coll.getHeader().empty()) return fail(error, "no header, not a .dsx export");
+	const std::vector<Component *> &comps = coll.getComponents();
+	mImpl->views.resize(comps.size());
+	for (size_t i = 0; i < comps.size(); i++) {
+		ComponentView &v = mImpl->views[i];
+		v.type = text(comps[i]->getType());
+		v.name = text(comps[i]->getName());
+		v.category = text(comps[i]->getCate());
+		v.offset = comps[i]->getSpan().ofs;
+		v.length = comps[i]->getSpan().len;
+		v.index = i;
+	}
+	return true;
+}
+
+size_t Export::size() const { return mImpl->views.size(); }
+const ComponentView & Export::operator[](size_t i) const { return mImpl->views[i]; }
+Export::const_iterator Export::begin() const { return mImpl->views.begin(); }
+Export::const_iterator Export::end() const { return mImpl->views.end(); }
+
+void Export::forEach(const std::function<bool(const ComponentView &)> &fn) const {
+	for (const ComponentView &v : mImpl->views)
+		if (!fn(v)) break;
+}
+
+Text Export::header() const {
+	return text(mImpl->coll.header());
+}
+
+std::string Export::path(const ComponentView &c) const {
+	Component *comp = mImpl->component(c);
+	if (comp == NULL) return std::string();
+	std::string path = comp->getPath() + Component::getDirSeptChar() + comp->getName() + mImpl->coll.ext();
+	// relative, the category starts with a separator
+	size_t s = path.find_first_not_of(Component::getDirSeptChar());
+	return path.substr(s == std::string::npos ? path.size() : s);
+}
+
+bool Export::pack(const ComponentView &c, Sink &sink) const {
+	Component *comp = mImpl->component(c);
+	if (comp == NULL) return false;
+	std::vector<piece_t> pieces;
+	mImpl->coll.pack0(comp, pieces);
+	for (const piece_t &p : pieces)
+		if (p.len > 0 && !sink.write(p.p, p.len)) return false;
+	return true;
+}
+
+std::string Export::pack(const ComponentView &c) const {
+	Component *comp = mImpl->component(c);
+	if (comp == NULL) return std::string();
+	std::vector<piece_t> pieces;
+	mImpl->coll.pack0(comp, pieces);
+	std::string out;
+	size_t n = 0;
+	for (const piece_t &p : pieces) n += p.len;
+	out.reserve(n);
+	for (const piece_t &p : pieces) out.append(p.p, p.len);
+	return out;
+}
+
+} // namespace dsxcut
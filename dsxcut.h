@@ -0,0 +1,125 @@
+
+/*
+
+Copyright (C) 2023, Steve Jin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+ * libdsxcut
+ *
+ * The splitter of dsxcut in a program: open a .dsx export from a file or a buffer,
+ * go over its components and pack any of them, as the .dsx dsxcut would write for
+ * it, into a sink of the caller. No process to start, no files to read back.
+ *
+ * 	std::string err;
+ * 	std::unique_ptr<dsxcut::Export> exp = dsxcut::Export::open("export.dsx", dsxcut::Export::Options(), &err);
+ * 	if (!exp) ... err
+ * 	for (const dsxcut::ComponentView &c : *exp)
+ * 		if (c.type.str() == "DSJOB") deploy(exp->path(c), exp->pack(c));
+ *
+ * This header is the stable interface: it only grows, DSXCUT_API_VERSION tells what
+ * is in it. Nothing of the parser (dsxcore.h) shows through, an Export holds it.
+ * An Export does not change once open: its views and pack() can be used from
+ * several threads at once. Exports share nothing, any number can be open and used
+ * at a time, from any thread.
+ */
+
+#ifndef DSXCUT_H
+#define DSXCUT_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define DSXCUT_API_VERSION 1
+
+namespace dsxcut {
+
+// bytes in the export or the Export, not 0 terminated
+struct Text {
+	const char *p;
+	size_t len;
+	std::string str() const { return std::string(p, len); }
+};
+
+// a component, valid while its Export is
+struct ComponentView {
+	Text type;		// of the export, e.g. "DSJOB", "DSROUTINES"
+	Text name;		// its Identifier
+	Text category;		// as in the export, e.g. "\\Jobs\\Load"
+	// where it is in the export, "BEGIN ..." to "END ...". With Options::stripBinaries
+	// too this is all of it, binaries included; pack() leaves them out, its content
+	// is shorter then.
+	size_t offset;
+	size_t length;
+	size_t index;		// in the Export, in file order
+};
+
+// where pack() puts a component
+class Sink {
+	public:
+	virtual ~Sink() {}
+	// false: stop, pack() fails
+	virtual bool write(const char *p, size_t n) = 0;
+};
+
+class Export {
+	public:
+	struct Options {
+		Options() : parseJobs(1), stripBinaries(false) {}
+		int parseJobs;		// parser threads, 0 for one per core
+		bool stripBinaries;	// pack without DSEXECJOB and DSBPBINARY, as --strip-binaries
+	};
+
+	// a .dsx file, mapped. NULL if it can't be read or is not a .dsx, error says why.
+	// gzip and XML exports are split by the dsxcut program only.
+	static std::unique_ptr<Export> open(const std::string &path, const Options &opt = Options(), std::string *error = NULL);
+	// a .dsx in memory, not copied: the caller keeps data until the Export is gone
+	static std::unique_ptr<Export> openBuffer(const char *data, size_t size, const Options &opt = Options(), std::string *error = NULL);
+	~Export();
+
+	// components, header not included, in file order
+	size_t size() const;
+	const ComponentView & operator[](size_t i) const;
+	typedef std::vector<ComponentView>::const_iterator const_iterator;
+	const_iterator begin() const;
+	const_iterator end() const;
+	// fn for each component, until it returns false
+	void forEach(const std::function<bool(const ComponentView &)> &fn) const;
+
+	// "BEGIN HEADER" ... "END HEADER", the start of each component packed
+	Text header() const;
+	// where dsxcut writes c, relative to -o: "Jobs/Load/Job_1.dsx" ('\' on Windows)
+	std::string path(const ComponentView &c) const;
+	// c as an import file, the content dsxcut writes to path(c). False if sink failed
+	bool pack(const ComponentView &c, Sink &sink) const;
+	std::string pack(const ComponentView &c) const;
+
+	private:
+	struct Impl;
+	std::unique_ptr<Impl> mImpl;
+
+	Export();
+	bool load(const Options &opt, std::string *error);
+};
+
+} // namespace dsxcut
+
+#endif // DSXCUT_H
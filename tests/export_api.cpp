@@ -0,0 +1,66 @@
+/*
+ * Client of libdsxcut for tests/run.sh: export_api <file.dsx> <dir> file|buffer [parse jobs]
+ * Writes the components of the export under dir as dsxcut would, from path() and
+ * pack(), the export opened by name or from a buffer.
+ */
+#include "dsxcut.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <boost/filesystem.hpp>
+
+// pack() into a file
+struct FileSink : dsxcut::Sink {
+	FILE *f;
+	bool write(const char *p, size_t n) { return fwrite(p, 1, n, f) == n; }
+};
+
+int main(int argc, char **argv) {
+	if (argc < 4) {
+		std::cerr << "usage: export_api <file.dsx> <dir> file|buffer [parse jobs]" << std::endl;
+		return 2;
+	}
+	dsxcut::Export::Options opt;
+	if (argc > 4) opt.parseJobs = atoi(argv[4]);
+	std::string err, buf;
+	std::unique_ptr<dsxcut::Export> exp;
+	if (std::string(argv[3]) == "buffer") {
+		std::ifstream in(argv[1], std::ifstream::binary);
+		std::stringstream ss;
+		ss << in.rdbuf();
+		buf = ss.str();
+		exp = dsxcut::Export::openBuffer(buf.data(), buf.size(), opt, &err);
+	} else
+		exp = dsxcut::Export::open(argv[1], opt, &err);
+	if (!exp) {
+		std::cerr << "Error: " << err << std::endl;
+		return 1;
+	}
+	size_t i = 0;
+	for (const dsxcut::ComponentView &c : *exp) {
+		if (c.index != i++ || &(*exp)[c.index] != &c) {
+			std::cerr << "Error: index of " << c.name.str() << std::endl;
+			return 1;
+		}
+		boost::filesystem::path p = boost::filesystem::path(argv[2]) / exp->path(c);
+		boost::filesystem::create_directories(p.parent_path());
+		FileSink sink;
+		sink.f = fopen(p.string().c_str(), "wb");
+		if (!sink.f || !exp->pack(c, sink) || fclose(sink.f) != 0) {
+			std::cerr << "Error: " << p.string() << " not written" << std::endl;
+			return 1;
+		}
+		// the string form is the same bytes
+		std::ifstream in(p.string(), std::ifstream::binary);
+		std::stringstream ss;
+		ss << in.rdbuf();
+		if (ss.str() != exp->pack(c)) {
+			std::cerr << "Error: pack() of " << c.name.str() << " differs" << std::endl;
+			return 1;
+		}
+	}
+	std::cout << exp->size() << " components" << std::endl;
+	return 0;
+}
@@ -0,0 +1,217 @@
+#!/bin/sh
+# Regression checks of dsxcut on small exports: tests/run.sh [path to dsxcut]
+# Runs in a temporary dir, removed at the end; -o of dsxcut is relative to it.
+DSXCUT=${1:-./dsxcut}
+case "$DSXCUT" in /*) ;; *) DSXCUT=$(pwd)/$DSXCUT ;; esac
+DIR=$(cd "$(dirname "$0")" && pwd)
+TMP=$(mktemp -d "${TMPDIR:-/tmp}/dsxcut-tests.XXXXXX") || exit 1
+trap 'rm -rf "$TMP"' EXIT
+cd "$TMP" || exit 1
+fail=0
+
+# check <what> <shell command>: ok if the command succeeds
+check() {
+	if eval "$2" >/dev/null 2>&1; then echo "ok   $1"; else echo "FAIL $1"; fail=1; fi
+}
+# listed <file> [options]: number of components dsxcut lists
+listed() {
+	lf=$1; shift
+	"$DSXCUT" "$lf" -l "$@" 2>/dev/null | grep -c '^\['
+}
+
+# split <dir> <dsxcut args>: split quietly into dir, a new one
+split() {
+	rm -rf "$1"
+	sd=$1; shift
+	"$DSXCUT" "$@" -q -o "$sd" >/dev/null 2>&1
+}
+# same <dir>: the tree of export.dsx, as split by the first dsxcut
+same() {
+	diff -r "$DIR/export_split" "$1"
+}
+# big.dsx, a synthetic export over the 4 MB parsed in parallel
+big() {
+	[ -f big.dsx ] || "$DSXCUT" --gen-synthetic big.dsx --gen-spec jobs=1000,routines=200,paramsets=20,body=4096,depth=3,seed=1 -q >/dev/null
+}
+
+# expect <n components> <file>: listed, exit 0
+expect() {
+	n=$1 f=$2
+	check "$f" '[ "$(listed "$DIR/$f")" = $n ]'
+	check "$f (-c)" '[ "$("$DSXCUT" -c -l < "$DIR/$f" 2>/dev/null | grep -c "^\[")" = $n ]'
+}
+
+# "BEGIN TRANSACTION" / "BEGIN CASE" lines of a routine source are not blocks
+expect 3 begin_in_source.dsx
+expect 4 begin_col0_in_source.dsx
+
+# an export cut in a block fails
+head -c 400 "$DIR/begin_in_source.dsx" > cut.dsx
+check "cut.dsx exits non-zero" '! "$DSXCUT" cut.dsx -q -o out'
+
+# the input mapped or read (--no-mmap): the same files
+check "split, mapped" 'split out "$DIR/export.dsx" && same out'
+check "split, --no-mmap" 'split out "$DIR/export.dsx" --no-mmap && same out'
+
+# stdin (-c), split while read: the same files
+check "split, -c" 'split out -c < "$DIR/export.dsx" && same out'
+
+# -j writers: the same files; a file that can't be written fails the run
+check "split, -j 4" 'split out "$DIR/export.dsx" -j 4 && same out'
+check "write error exits non-zero" 'rm -rf out && mkdir out && touch out/Jobs && ! "$DSXCUT" "$DIR/export.dsx" -j 4 -q -o out'
+
+# parsed by 4 threads: the same components and files as serially
+big
+check "--parse-jobs 4" 'split p1 big.dsx --parse-jobs 1 && split p4 big.dsx --parse-jobs 4 && diff -r p1 p4 &&
+	[ "$(listed big.dsx --parse-jobs 4)" = 1220 ]'
+
+# a component without Category goes to the top of -o; escaped \\ in one are separators
+check "no Category, nested Category" 'split out "$DIR/no_category.dsx" && [ -f out/Job_NoCat.dsx ] &&
+	[ -f "out/Routines/A B/C/RT_Deep.dsx" ]'
+
+# files written from pieces, or copied in the kernel (--copy-range): the same bytes
+check "split, --copy-range" 'split out "$DIR/export.dsx" --copy-range && same out'
+
+# -i: unchanged files are skipped, a changed one rewritten; --prune removes the files
+# of components gone (export_pruned.dsx: no Job_B, RT_Other) and the dirs left empty
+rm -rf inc
+"$DSXCUT" "$DIR/export.dsx" -i -q -o inc >/dev/null 2>&1
+check "-i, first run" 'diff -r -x .dsxcut.manifest "$DIR/export_split" inc && [ -f inc/.dsxcut.manifest ]'
+check "-i, unchanged" '"$DSXCUT" "$DIR/export.dsx" -i -o inc | grep -q "Written 0, skipped 7 (unchanged), removed 0"'
+echo changed >> inc/Jobs/Load/Job_A.dsx
+check "-i --prune" '"$DSXCUT" "$DIR/export_pruned.dsx" -i --prune -o inc | grep -q "Written 1, skipped 4 (unchanged), removed 2" &&
+	cmp inc/Jobs/Load/Job_A.dsx "$DIR/export_split/Jobs/Load/Job_A.dsx" &&
+	[ ! -e inc/Jobs/Report ] && [ ! -e inc/Routines/Misc ] && [ -f inc/Routines/Util/RT_Fmt.dsx ]'
+
+# --index: written by the first run, used by the next; not used once the input
+# changed, even at the same size and mtime (a header byte)
+cp "$DIR/export.dsx" idx.dsx
+check "--index, written" 'split out idx.dsx --index && same out && [ -f idx.dsxidx ]'
+check "--index, used" '"$DSXCUT" idx.dsx --index -o out | grep -q "Index idx.dsxidx used" && same out'
+sed 's/Date "2023-01-01"/Date "2023-01-02"/' "$DIR/export.dsx" > idx2.dsx && touch -r idx.dsx idx2.dsx && mv idx2.dsx idx.dsx
+check "--index, stale header" '! "$DSXCUT" idx.dsx --index -l -o out | grep -q "Index idx.dsxidx used"'
+
+# --only/--type/--category; a name listed is not reported missing, whether parsed
+# serially, in parallel or taken from the index
+check "--only, --type, --category" '[ "$(listed "$DIR/export.dsx" --only "RT_*" --only Job_B)" = 4 ] &&
+	[ "$(listed "$DIR/export.dsx" --type JOB)" = 2 ] && [ "$(listed "$DIR/export.dsx" --category "\\\\Routines\\\\*")" = 3 ] &&
+	[ "$(listed "$DIR/export.dsx" --category "/Jobs/L*")" = 1 ]'
+check "--only, missing name warned" '"$DSXCUT" "$DIR/export.dsx" -l --only Job_X 2>&1 | grep -q "component Job_X not found"'
+cp "$DIR/export.dsx" only.dsx
+"$DSXCUT" only.dsx --index -q -o out >/dev/null 2>&1
+check "--only, from the index" '"$DSXCUT" only.dsx --index -l --only Job_B -o out 2>&1 >/dev/null | grep -c "not found" | grep -qx 0 &&
+	[ "$(listed only.dsx --index --only Job_B)" = 1 ]'
+check "--only, parsed in parallel" '"$DSXCUT" big.dsx -l --only Job_000001 --only "RT_0000*" --parse-jobs 4 -o out 2>&1 >/dev/null | grep -c "not found" | grep -qx 0 &&
+	[ "$(listed big.dsx --only Job_000001 --only "RT_0000*" --parse-jobs 4)" = 101 ]'
+
+# --compose of a split tree, split again: the same tree
+check "--compose round trip" '"$DSXCUT" --compose "$DIR/export_split" -o composed.dsx -q >/dev/null 2>&1 &&
+	[ "$(listed composed.dsx)" = 7 ] && split out composed.dsx && same out'
+
+# batch: each input into a dir named after it; a component of an earlier input is
+# linked to, not written again, only if the headers are the same too
+cp "$DIR/export.dsx" a.dsx && cp "$DIR/export.dsx" a3.dsx
+sed 's/Date "2023-01-01"/Date "2025-05-05"/' "$DIR/export.dsx" > a2.dsx
+split a2 a2.dsx
+check "batch" 'split b a.dsx a2.dsx a3.dsx -j 4 && same b/a && same b/a3 && diff -r a2 b/a2'
+check "batch, linked" '[ "$(find b/a3 -type f -links 2 | wc -l)" -eq 7 ] && [ "$(find b/a2 -type f -links 1 | wc -l)" -eq 7 ]'
+
+# --gen-synthetic: the same spec and seed, the same file; --bench appends a JSON line
+check "--gen-synthetic" '"$DSXCUT" --gen-synthetic big2.dsx --gen-spec jobs=1000,routines=200,paramsets=20,body=4096,depth=3,seed=1 -q &&
+	cmp big.dsx big2.dsx && [ "$(listed big2.dsx --type JOB)" = 1000 ]'
+check "--bench" '"$DSXCUT" --bench "$DIR/export.dsx" -o bench --bench-out bench.jsonl -q &&
+	"$DSXCUT" --bench "$DIR/export.dsx" -o bench --bench-out bench.jsonl -q &&
+	[ "$(grep -c "\"components\":7,.*\"writeFile\"" bench.jsonl)" = 2 ]'
+
+# --stats=json: bytes, components per type, dirs created, write errors
+check "--stats" 'rm -rf out && "$DSXCUT" "$DIR/export.dsx" --stats=json --stats-out stats.json -q -o out &&
+	grep -q "\"bytes_in\":2580,.*\"DSROUTINES\":3,.*\"dirs_created\":6,\"linked\":0,\"write_errors\":0" stats.json'
+
+# --memory-limit below what big.dsx needs: streamed, the same files
+check "--memory-limit" 'split m1 big.dsx --memory-limit 1 && diff -r p1 m1'
+
+# the SIMD marker kernels find what the scalar one does (--bench fails otherwise)
+check "marker kernels agree" '"$DSXCUT" --bench big.dsx -o bench --bench-out bench.jsonl -q'
+
+# --diff: added, removed and changed components, exit 1 if any; --diff-ignore leaves
+# attribute lines out; -u of a long routine rewritten whole stays in linear memory
+sed 's/R%10/R%12/; s/DateModified "2023-03-02"/DateModified "2024-01-01"/' "$DIR/export.dsx" > d2.dsx
+check "--diff, same" '"$DSXCUT" --diff "$DIR/export.dsx" a.dsx | grep -q "0 added, 0 removed, 0 changed, 7 same"'
+check "--diff" '! "$DSXCUT" --diff "$DIR/export.dsx" "$DIR/export_pruned.dsx" > diff.out &&
+	grep -q "0 added, 2 removed, 0 changed, 5 same" diff.out && grep -q "^-  DSJOB .* Job_B" diff.out'
+check "--diff -u --diff-ignore" '! "$DSXCUT" --diff "$DIR/export.dsx" d2.dsx -u --diff-ignore DateModified > diff.out &&
+	grep -q "1 changed, 6 same" diff.out && grep -q "^-Ans = Fmt(Arg1, \"R%10\")" diff.out && grep -q "^+Ans = Fmt(Arg1, \"R%12\")" diff.out'
+routine() {
+	printf 'BEGIN HEADER\r\n   CharacterSet "CP1252"\r\nEND HEADER\r\nBEGIN DSROUTINES\r\n   BEGIN DSRECORD\r\n'
+	printf '      Identifier "RT_Long"\r\n      Category "\\\\Routines"\r\n      Source =+=+=+=\r\n'
+	awk -v p="$1" 'BEGIN { for (i = 0; i < 6000; i++) printf "%s%d\r\n", p, i }'
+	printf '=+=+=+=\r\n   END DSRECORD\r\nEND DSROUTINES\r\n'
+}
+routine L > long1.dsx && routine M > long2.dsx
+check "--diff -u, 12000 edits in 200 MB" '[ "$(ulimit -v 200000; "$DSXCUT" --diff long1.dsx long2.dsx -u | grep -c "^[-+][LM]")" = 12000 ]'
+
+# --tar: the tree in one archive, gzip for .tgz; paths over 100 bytes in a ustar
+# prefix, over 255 in a PAX header
+check "--tar" '"$DSXCUT" "$DIR/export.dsx" --tar -o out.tar -q >/dev/null 2>&1 && rm -rf t && mkdir t && tar xf out.tar -C t && same t'
+check "--tar, .tgz" '"$DSXCUT" "$DIR/export.dsx" --tar -o out.tgz -q >/dev/null 2>&1 && rm -rf t && mkdir t && tar xzf out.tgz -C t && same t'
+long=Category_with_a_rather_long_name_to_go_over_the_ustar_limits
+sed "s/Jobs\\\\\\\\Load/Jobs\\\\\\\\$long\\\\\\\\$long/; s/Jobs\\\\\\\\Report/Jobs\\\\\\\\$long\\\\\\\\$long\\\\\\\\$long\\\\\\\\$long\\\\\\\\$long/" "$DIR/export.dsx" > long.dsx
+check "--tar, long paths" 'split l long.dsx && "$DSXCUT" long.dsx --tar -o long.tar -q >/dev/null 2>&1 && rm -rf t && mkdir t &&
+	tar xf long.tar -C t && diff -r l t && [ -f "t/Jobs/$long/$long/Job_A.dsx" ]'
+
+# gzip input, by name or on -c, inflated while split: the same files
+gzip -c "$DIR/export.dsx" > gz.dsx.gz
+check ".gz input" 'split out gz.dsx.gz && same out'
+check ".gz input, -c" 'split out -c < gz.dsx.gz && same out'
+check ".gz input, batch" 'split b gz.dsx.gz a.dsx && same b/gz && same b/a'
+
+# --types: table definitions are skipped by default; other types, and an index of
+# other types is not used
+check "--types" '[ "$(listed "$DIR/export.dsx" --types JOB,TD)" = 3 ] && [ "$(listed "$DIR/export.dsx" --types DSTABLEDEFS)" = 1 ] &&
+	! "$DSXCUT" "$DIR/export.dsx" --types XX -l >/dev/null 2>&1'
+check "--types, index" '! "$DSXCUT" only.dsx --index --types JOB -l | grep -q "used, not parsed" && [ "$(listed only.dsx --index --types JOB)" = 2 ]'
+
+# --closure: a job and what it uses; --closure-dsx - is a .dsx on stdout, notes on
+# stderr; a name that matches nothing fails
+sed 's/DSU.RT_Fmt/DSU.RT_Gone/' "$DIR/export.dsx" > gone.dsx
+check "--closure" '[ "$(listed "$DIR/export.dsx" --closure Job_A)" = 4 ] && [ "$(listed "$DIR/export.dsx" --closure "Job_*")" = 5 ]'
+check "--closure-dsx -" '"$DSXCUT" gone.dsx --closure Job_A --closure-dsx - -q 2>closure.err > closure.dsx &&
+	grep -q "Not in export: DSROUTINES RT_Gone" closure.err && [ "$(listed closure.dsx)" = 3 ] && head -1 closure.dsx | grep -q "^BEGIN HEADER"'
+check "--closure, unknown name" '! "$DSXCUT" "$DIR/export.dsx" --closure Job_X -l'
+
+# --strip-binaries: the DSEXECJOB block left out, loaded or streamed
+rm -rf strip && cp -r "$DIR/export_split" strip && sed '/BEGIN DSEXECJOB/,/END DSEXECJOB/d' "$DIR/export_split/Jobs/Load/Job_A.dsx" > strip/Jobs/Load/Job_A.dsx
+check "--strip-binaries" 'split out "$DIR/export.dsx" --strip-binaries && diff -r strip out'
+check "--strip-binaries, -c" 'split out --strip-binaries -c < "$DIR/export.dsx" && diff -r strip out'
+
+# a write cut short (here by the file size limit) fails the run and leaves the old
+# index and manifest in place, no temporary file behind
+cp "$DIR/export.dsx" short.dsx
+"$DSXCUT" short.dsx --index -i -q -o short >/dev/null 2>&1
+cp short.dsxidx short.idx0; cp short/.dsxcut.manifest short.man0
+printf '\r\n' >> short.dsx; rm short/Jobs/Load/Job_A.dsx
+check "short write, fails" '! (trap "" XFSZ; ulimit -f 0; "$DSXCUT" short.dsx --index -i -q -o short) >/dev/null 2>&1'
+check "short write, old files kept" 'cmp -s short.idx0 short.dsxidx && cmp -s short.man0 short/.dsxcut.manifest &&
+	[ -z "$(find . -name "*.tmp")" ]'
+
+# XML export: a file per job and per record of a group, the group start and end tags
+# around it as indented in the export; by name, on -c and gzip compressed
+gzip -c "$DIR/export.xml" > x.xml.gz
+check "XML split" 'split out "$DIR/export.xml" && diff -r "$DIR/export_xml_split" out'
+check "XML split, -c" 'split out -c < "$DIR/export.xml" && diff -r "$DIR/export_xml_split" out'
+check "XML split, .gz" 'split out x.xml.gz && diff -r "$DIR/export_xml_split" out'
+check "XML split, --only" '[ "$(listed "$DIR/export.xml" --only "RT_*")" = 2 ]'
+
+# libdsxcut: a client of the Export API packs the same files as dsxcut, the export
+# opened by name or from a buffer, parsed serially or in parallel. Skipped if the
+# client does not build here
+if ${CXX:-g++} -std=c++11 -I"$DIR/.." "$DIR/export_api.cpp" "$DIR/../dsxcut.cpp" -o export_api \
+	-lboost_filesystem -lboost_system -lpthread -lz >/dev/null 2>&1; then
+	check "Export API, file" 'rm -rf api && ./export_api "$DIR/export.dsx" api file && same api'
+	check "Export API, buffer, parallel" 'rm -rf api && ./export_api "$DIR/export.dsx" api buffer 4 && same api'
+	check "Export API, not a .dsx" '! ./export_api "$DIR/export.xml" api file'
+else
+	echo "skip Export API, the client does not build"
+fi
+
+exit $fail